@@ -0,0 +1,43 @@
+// admission.hpp
+// Shimmer
+// author: beefviper
+// date: July 27, 2025
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <filesystem>
+
+#include <Windows.h>
+
+#include "ini.hpp"
+
+namespace shim
+{
+
+class Admission
+{
+public:
+	Admission(const Shim& shim, const std::filesystem::path& logPath);
+	~Admission();
+
+	Admission(const Admission&) = delete;
+	Admission& operator=(const Admission&) = delete;
+
+	bool acquire();
+
+private:
+	std::string alias;
+	unsigned maxConcurrent{ 0 };
+	unsigned long maxWait{ 0 };
+	std::filesystem::path logPath;
+
+	HANDLE gate{ nullptr };
+	std::vector<HANDLE> slots;
+	HANDLE held{ nullptr };
+
+	void report(unsigned long long waitedMs, bool admitted) const;
+};
+
+} // namespace shim
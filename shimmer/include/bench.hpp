@@ -0,0 +1,35 @@
+// bench.hpp
+// Shimmer
+// author: beefviper
+// date: July 27, 2025
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <functional>
+#include <filesystem>
+
+namespace shim
+{
+
+class Bench
+{
+public:
+	explicit Bench(const std::vector<size_t>& sizes);
+	~Bench();
+
+	void run();
+
+private:
+	std::vector<size_t> sizes;
+	std::filesystem::path workDir;
+	std::filesystem::path stubSource;
+
+	void generateConfig(size_t count) const;
+	void generatePath(size_t count) const;
+	void measure(const std::string& operation, size_t count, const std::function<void()>& body) const;
+};
+
+} // namespace shim
@@ -0,0 +1,46 @@
+// doctor.hpp
+// Shimmer
+// author: beefviper
+// date: July 27, 2025
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <filesystem>
+
+#include "ini.hpp"
+#include "path.hpp"
+
+namespace shim
+{
+
+struct Finding
+{
+	std::string alias;
+	std::string check;
+	std::string detail;
+};
+
+class Doctor
+{
+public:
+	Doctor(const Ini& ini, const Path& paths);
+
+	bool run(ListFormat format) const;
+
+private:
+	const Ini& ini;
+	const Path& paths;
+	std::vector<Shim> shims;
+	std::vector<Shim> ruleStubs;
+	std::filesystem::path shimDir;
+
+	std::vector<Finding> checkFiles() const;
+	std::vector<Finding> checkCollisions() const;
+	std::vector<Finding> checkChains() const;
+	std::vector<Finding> checkPath() const;
+	void report(const std::vector<Finding>& findings, ListFormat format) const;
+};
+
+} // namespace shim
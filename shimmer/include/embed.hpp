@@ -0,0 +1,23 @@
+// embed.hpp
+// Shimmer
+// author: beefviper
+// date: July 27, 2025
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <filesystem>
+
+#include "ini.hpp"
+
+namespace shim
+{
+
+// a stub may carry its own shimmer.ini line in a trailer after the PE image:
+// [record][record size, 8 bytes little endian]["SHIMREC1"]
+std::uintmax_t imageSize(const std::filesystem::path& exe);
+std::optional<Shim> readEmbedded(const std::filesystem::path& exe);
+bool stampStub(const std::filesystem::path& stub, const Shim& shim);
+
+} // namespace shim
@@ -7,9 +7,13 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
+#include <utility>
+#include <optional>
 #include <filesystem>
 
 #include "registry.hpp"
+#include "pattern.hpp"
 
 namespace shim
 {
@@ -17,7 +21,27 @@ namespace shim
 enum class ShimMode
 {
 	Wait,
-	Detached
+	Detached,
+	Memo
+};
+
+enum class Priority
+{
+	Default,
+	Idle,
+	BelowNormal,
+	Normal,
+	AboveNormal,
+	High,
+	Realtime
+};
+
+enum class IoPriority
+{
+	Default,
+	VeryLow,
+	Low,
+	Normal
 };
 
 struct Shim
@@ -25,6 +49,53 @@ struct Shim
 	std::string alias;
 	std::string program;
 	ShimMode mode{ ShimMode::Wait };
+
+	// Memo mode: environment variables and (unless turned off) the working directory that take part
+	// in the cache key, and cache size per shim
+	std::vector<std::string> memoEnv;
+	bool memoCwd{ true };
+	std::uintmax_t memoLimit{ 16 * 1024 * 1024 };
+
+	// admission control: instances allowed to run at once (0 = unlimited), and how long to queue in ms (0 = forever);
+	// a Detached shim exits right after the launch, so it only holds its slot while starting the target
+	unsigned maxConcurrent{ 0 };
+	unsigned long maxWait{ 0 };
+
+	// launch policy: CPU mask (0 = inherit), priority class and I/O priority of the target
+	std::uint64_t affinity{ 0 };
+	Priority priority{ Priority::Default };
+	IoPriority ioPriority{ IoPriority::Default };
+
+	// bake this record into the stub so it launches without the registry or shimmer.ini
+	bool embed{ false };
+
+	// filled in on add/rebuild when program is another shim's stub: the aliases passed through
+	// and the final target launched in their place (empty while the chain is a cycle)
+	std::vector<std::string> via;
+	std::string resolved;
+};
+
+// options follow the mode in shimmer.ini as "| key=value"
+bool applyOption(Shim& shim, const std::string& option);
+std::vector<std::pair<std::string, std::string>> shimOptions(const Shim& shim);
+
+// one shimmer.ini entry: alias = "program" | Mode | key=value ...
+bool parseShimLine(const std::string& line, Shim& shim, std::string& error);
+std::string formatShimLine(const Shim& shim);
+std::string formatChain(const std::string& alias, const std::vector<std::string>& via);
+
+enum class ListFormat
+{
+	Text,
+	Json,
+	Tsv
+};
+
+struct ListFilter
+{
+	std::string prefix;
+	std::optional<ShimMode> mode;
+	ListFormat format{ ListFormat::Text };
 };
 
 class Ini
@@ -36,17 +107,58 @@ public:
 
 	std::vector<Shim> getShims() const;
 	std::filesystem::path getPath() const;
+	void setStubSource(const std::filesystem::path& source);
+	const Shim* find(const std::string& alias) const;
+	std::optional<Shim> resolve(const std::string& name) const;
+	bool chain(const Shim& shim, std::vector<std::string>& via, std::string& resolved) const;
 
 	bool add(const Shim& shim);
 	bool remove(const std::string& alias);
-	void list() const;
-	void rebuild() const;
+	bool addRuleStub(const std::string& name);
+	std::vector<Shim> ruleStubs() const;
+	void begin();
+	bool commit();
+	void list(const ListFilter& filter = {}) const;
+	void rebuild();
 	void writeDefault() const;
 
 private:
 	Registry registry{ "Software\\Shimmer" };
 	std::filesystem::path iniPath;
+	std::filesystem::path stubSource;
 	std::vector<Shim> shims;
+
+	// positions in shims ordered by alias: taken from a sorted shimmer.ini on load, otherwise sorted
+	// on first use by list() or save(); add/remove keep it current
+	mutable std::vector<size_t> index;
+	mutable bool indexStale{ true };
+
+	// pattern rules in shimmer.ini order; the matcher is compiled by save() into shimmer.dfa
+	// and loaded from there on the first lookup an exact alias cannot answer
+	mutable std::vector<size_t> patternRules;
+	mutable PatternMatcher matcher;
+	mutable bool matcherStale{ true };
+
+	bool dirty{ false };
+	bool deferred{ false };
+	std::vector<std::string> staged;
+	std::vector<std::string> committedAliases;
+
+	void load();
+	bool save() const;
+	std::filesystem::path stubImage() const;
+	void adoptIndex();
+	const std::vector<size_t>& sortedIndex() const;
+	std::vector<std::string> collectPatterns() const;
+	const PatternMatcher& patternMatcher() const;
+	std::filesystem::path matcherPath() const;
+	void saveMatcher() const;
+	std::optional<Shim> lookup(const std::string& name) const;
+	std::optional<std::string> stubAlias(const std::string& program) const;
+	std::vector<std::string> flatten();
+	void restamp(const std::vector<std::string>& aliases) const;
+	std::filesystem::path retire(const std::filesystem::path& stubPath) const;
+	void reap() const;
 };
 
 } // namespace shim
@@ -0,0 +1,15 @@
+// json.hpp
+// Shimmer
+// author: beefviper
+// date: July 27, 2025
+
+#pragma once
+
+#include <string>
+
+namespace shim
+{
+
+void appendJsonString(std::string& out, const std::string& value);
+
+} // namespace shim
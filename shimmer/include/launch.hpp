@@ -0,0 +1,20 @@
+// launch.hpp
+// Shimmer
+// author: beefviper
+// date: July 27, 2025
+
+#pragma once
+
+#include <string>
+
+#include <Windows.h>
+
+#include "ini.hpp"
+
+namespace shim
+{
+
+bool launch(const Shim& shim, std::string commandLine, bool inheritHandles,
+	STARTUPINFOA& startupInfo, PROCESS_INFORMATION& processInfo);
+
+} // namespace shim
@@ -0,0 +1,35 @@
+// memo.hpp
+// Shimmer
+// author: beefviper
+// date: July 27, 2025
+
+#pragma once
+
+#include <string>
+#include <optional>
+#include <filesystem>
+
+#include "ini.hpp"
+
+namespace shim
+{
+
+class Memo
+{
+public:
+	Memo(const Shim& shim, const std::filesystem::path& cacheRoot);
+
+	int run(const std::string& commandLine, int argc, char* argv[]) const;
+
+private:
+	Shim shim;
+	std::filesystem::path cacheDir;
+
+	std::string cacheKey(int argc, char* argv[]) const;
+	std::optional<int> replay(const std::filesystem::path& entry, const std::string& key) const;
+	void store(const std::filesystem::path& entry, const std::string& key, int exitCode,
+		const std::string& out, const std::string& err) const;
+	void evict() const;
+};
+
+} // namespace shim
@@ -18,14 +18,19 @@ class Path
 {
 public:
 	explicit Path();
+	explicit Path(const std::string& subKey);
 
 	bool contains(const std::filesystem::path& testPath) const;
 	void add(const std::filesystem::path& newPath);
 	void remove(const std::filesystem::path& targetPath);
+	void begin();
+	void commit();
 
 private:
 	std::vector<std::filesystem::path> paths;
-	Registry registry{ "Environment" };
+	Registry registry;
+	bool dirty{ false };
+	bool deferred{ false };
 
 	std::vector<std::filesystem::path> splitEnvPaths(const std::string& pathStr);
 	std::string joinEnvPaths(const std::vector<std::filesystem::path>& pathList);
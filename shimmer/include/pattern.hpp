@@ -0,0 +1,54 @@
+// pattern.hpp
+// Shimmer
+// author: beefviper
+// date: July 27, 2025
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <optional>
+#include <filesystem>
+
+namespace shim
+{
+
+// an alias containing '*' is a rule for every exe stem it matches, e.g.
+// clang-* = "C:\llvm\{1}\bin\clang.exe"; {N} is the text the Nth '*' matched
+bool isPattern(const std::string& alias);
+bool matchCaptures(const std::string& pattern, const std::string& name, std::vector<std::string>& captures);
+std::string expandCaptures(const std::string& program, const std::string& name, const std::vector<std::string>& captures);
+
+// all rules compiled into one DFA, so a name is resolved in a single pass over its characters
+// instead of trying each rule; where rules overlap the one listed first wins. Compiling is done
+// when the config is saved and the tables are stored beside it, so dispatch only loads them;
+// until compiled or loaded, match() tries each rule in order
+class PatternMatcher
+{
+public:
+	PatternMatcher() = default;
+	explicit PatternMatcher(const std::vector<std::string>& patterns);
+
+	void compile();
+	bool save(const std::filesystem::path& path) const;
+	bool load(const std::filesystem::path& path);
+	std::optional<size_t> match(const std::string& name) const;
+
+private:
+	static constexpr std::uint32_t DEAD_STATE = 0;
+	static constexpr std::uint32_t START_STATE = 1;
+	static constexpr size_t NO_RULE = SIZE_MAX;
+	static constexpr size_t MAX_STATES = 1 << 16;
+
+	std::vector<std::string> rules;
+	std::vector<std::uint8_t> classOf = std::vector<std::uint8_t>(256, 0);
+	size_t classCount{ 1 };
+	std::vector<std::uint32_t> transitions;
+	std::vector<size_t> accepting;
+	bool compiled{ false };
+
+	std::uint64_t rulesHash() const;
+};
+
+} // namespace shim
@@ -0,0 +1,32 @@
+// shell.hpp
+// Shimmer
+// author: beefviper
+// date: July 27, 2025
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <optional>
+#include <filesystem>
+
+#include "ini.hpp"
+
+namespace shim
+{
+
+enum class Shell
+{
+	Bash,
+	Zsh,
+	Fish,
+	Pwsh
+};
+
+std::optional<Shell> parseShell(const std::string& shellStr);
+std::filesystem::path shellScriptPath(Shell shell, const std::filesystem::path& shimDir);
+std::string shellInit(Shell shell, const std::vector<Shim>& shims, const std::filesystem::path& shimDir);
+bool writeShellScript(Shell shell, const std::vector<Shim>& shims, const std::filesystem::path& shimDir);
+void refreshShellScripts(const std::vector<Shim>& shims, const std::filesystem::path& shimDir);
+
+} // namespace shim
@@ -15,6 +15,9 @@ namespace shim
 {
 
 shim::ShimMode parseMode(const std::string& modeStr);
+std::optional<shim::Shim> makeShim(const std::string& name, const std::string& target, const std::vector<std::string>& extra);
+std::optional<shim::ListFormat> parseFormat(const std::string& formatStr);
+bool isCommand(const std::string& arg);
 std::string joinArgs(int argc, char* argv[]);
 
 class Shimmer
@@ -25,11 +28,15 @@ public:
 	void install();
 	void uninstall();
 	void init() const;
-	void create(const std::string& name, const std::string& target, ShimMode mode) const;
-	void update(const std::string& target, ShimMode mode) const;
-	void remove(std::string target) const;
-	void list() const;
+	bool create(const Shim& shim) const;
+	bool update(Shim shim) const;
+	bool remove(std::string target) const;
+	bool stub(const std::string& name) const;
+	bool batch(const std::string& source);
+	void list(const ListFilter& filter) const;
 	void rebuild() const;
+	bool doctor(ListFormat format) const;
+	bool shellInit(const std::string& shellStr) const;
 	void version() const;
 	void printHelp() const;
 
@@ -40,6 +47,9 @@ public:
 
 	std::string currentExeName{};
 	std::filesystem::path currentExeDir{};
+
+	bool batching{ false };
+	std::string pendingInstalledPath{};
 };
 
 } // namespace shim
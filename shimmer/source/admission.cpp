@@ -0,0 +1,105 @@
+// admission.cpp
+// Shimmer
+// author: beefviper
+// date: July 27, 2025
+
+#include "admission.hpp"
+
+#include <chrono>
+#include <fstream>
+
+namespace shim
+{
+
+static bool acquired(DWORD result, size_t count)
+{
+	// an abandoned mutex belonged to a shim that died holding it; the slot is ours now
+	return result - WAIT_OBJECT_0 < count || result - WAIT_ABANDONED_0 < count;
+}
+
+Admission::Admission(const Shim& shim, const std::filesystem::path& logPath) :
+	alias(shim.alias),
+	maxConcurrent(shim.maxConcurrent),
+	maxWait(shim.maxWait),
+	logPath(logPath)
+{
+	// named mutexes rather than a semaphore: Windows releases a mutex when its owner dies,
+	// so a crashed or killed instance can never leak a slot
+	std::string prefix = "Local\\shimmer." + alias + ".";
+	gate = CreateMutexA(nullptr, FALSE, (prefix + "gate").c_str());
+	for (unsigned i = 0; i < maxConcurrent; ++i)
+	{
+		HANDLE slot = CreateMutexA(nullptr, FALSE, (prefix + "slot" + std::to_string(i)).c_str());
+		if (slot)
+		{
+			slots.push_back(slot);
+		}
+	}
+}
+
+Admission::~Admission()
+{
+	if (held)
+	{
+		ReleaseMutex(held);
+	}
+	for (HANDLE slot : slots)
+	{
+		CloseHandle(slot);
+	}
+	if (gate)
+	{
+		CloseHandle(gate);
+	}
+}
+
+bool Admission::acquire()
+{
+	if (!gate || slots.empty())
+	{
+		return true;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	auto remaining = [&]() -> DWORD
+		{
+			if (maxWait == 0)
+			{
+				return INFINITE;
+			}
+			auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+			return elapsed >= static_cast<long long>(maxWait) ? 0 : static_cast<DWORD>(maxWait - elapsed);
+		};
+
+	// only the waiter holding the gate competes for a slot, so instances queue on the gate in
+	// arrival order (as far as Windows keeps mutex waiters in order) instead of racing for slots
+	DWORD result = WaitForSingleObject(gate, remaining());
+	if (!acquired(result, 1))
+	{
+		report(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count(), false);
+		return false;
+	}
+
+	result = WaitForMultipleObjects(static_cast<DWORD>(slots.size()), slots.data(), FALSE, remaining());
+	if (acquired(result, slots.size()))
+	{
+		held = slots[result >= WAIT_ABANDONED_0 ? result - WAIT_ABANDONED_0 : result - WAIT_OBJECT_0];
+	}
+	ReleaseMutex(gate);
+
+	auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	if (waited > 0 || !held)
+	{
+		report(waited, held != nullptr);
+	}
+	return held != nullptr;
+}
+
+void Admission::report(unsigned long long waitedMs, bool admitted) const
+{
+	// one line per queued launch, for tuning max_concurrent: alias, wait, limit, outcome
+	std::ofstream log(logPath, std::ios::app);
+	log << alias << '\t' << waitedMs << '\t' << maxConcurrent << '\t' << (admitted ? "admitted" : "timeout") << '\n';
+}
+
+} // namespace shim
@@ -0,0 +1,221 @@
+// bench.cpp
+// Shimmer
+// author: beefviper
+// date: July 27, 2025
+
+#include "bench.hpp"
+#include "ini.hpp"
+#include "path.hpp"
+#include "registry.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+#include <Windows.h>
+
+namespace shim
+{
+
+// stand-ins so the benchmark never touches the real install, shims or user PATH
+static constexpr const char* BENCH_REGISTRY_KEY = "Software\\Shimmer\\Bench";
+static constexpr const char* BENCH_PATH_VALUE = "PATH";
+
+static const std::vector<size_t> DEFAULT_SIZES{ 1000, 10000, 100000 };
+
+class CountingBuffer : public std::streambuf
+{
+public:
+	std::uint64_t count{};
+
+protected:
+	int_type overflow(int_type c) override
+	{
+		if (!traits_type::eq_int_type(c, traits_type::eof()))
+		{
+			++count;
+		}
+		return traits_type::not_eof(c);
+	}
+
+	std::streamsize xsputn(const char*, std::streamsize n) override
+	{
+		count += static_cast<std::uint64_t>(n);
+		return n;
+	}
+};
+
+static std::string syntheticAlias(size_t index)
+{
+	std::ostringstream alias;
+	alias << "tool" << std::setw(6) << std::setfill('0') << index;
+	return alias.str();
+}
+
+Bench::Bench(const std::vector<size_t>& sizes) :
+	sizes(sizes.empty() ? DEFAULT_SIZES : sizes)
+{
+	workDir = std::filesystem::temp_directory_path() / ("shimmer-bench-" + std::to_string(GetCurrentProcessId()));
+	std::filesystem::create_directories(workDir);
+
+	// a few bytes instead of the real exe, so --rebuild at 100k measures shimmer and not the disk
+	stubSource = workDir / "stub.bin";
+	std::ofstream(stubSource, std::ios::binary) << "MZ shimmer bench stub";
+}
+
+Bench::~Bench()
+{
+	std::error_code ec;
+	std::filesystem::remove_all(workDir, ec);
+	RegDeleteTreeA(HKEY_CURRENT_USER, BENCH_REGISTRY_KEY);
+}
+
+void Bench::run()
+{
+	std::cout << std::left
+		<< std::setw(16) << "operation"
+		<< std::setw(10) << "shims"
+		<< std::setw(14) << "ms"
+		<< std::setw(12) << "io_ops"
+		<< std::setw(14) << "disk_bytes"
+		<< "console_bytes" << "\n";
+
+	for (size_t count : sizes)
+	{
+		std::filesystem::path shimDir = workDir / std::to_string(count);
+		std::filesystem::create_directories(shimDir);
+
+		generateConfig(count);
+		generatePath(count);
+
+		measure("load", count, [&]()
+			{
+				Ini ini(shimDir);
+			});
+
+		// --init only does work where there is no shimmer.ini yet, so it gets a directory of its own
+		std::filesystem::path initDir = workDir / (std::to_string(count) + "-init");
+		std::filesystem::create_directories(initDir);
+		measure("--init", count, [&]()
+			{
+				Ini ini(initDir);
+				if (!std::filesystem::exists(ini.getPath()))
+				{
+					ini.writeDefault();
+				}
+			});
+
+		measure("--create", count, [&]()
+			{
+				Ini ini(shimDir);
+				ini.setStubSource(stubSource);
+				ini.add({ "bench-new", "C:\\bench\\bench-new.exe", ShimMode::Wait });
+			});
+
+		measure("--remove", count, [&]()
+			{
+				Ini ini(shimDir);
+				ini.remove("bench-new");
+			});
+
+		measure("--list", count, [&]()
+			{
+				Ini ini(shimDir);
+				ini.list();
+			});
+
+		measure("--rebuild", count, [&]()
+			{
+				Ini ini(shimDir);
+				ini.setStubSource(stubSource);
+				ini.rebuild();
+			});
+
+		std::filesystem::path missingDir = workDir / "not-on-path";
+		std::filesystem::create_directories(missingDir);
+
+		measure("Path::contains", count, [&]()
+			{
+				Path path(BENCH_REGISTRY_KEY);
+				path.contains(missingDir);
+			});
+
+		measure("Path::add", count, [&]()
+			{
+				Path path(BENCH_REGISTRY_KEY);
+				path.add(missingDir);
+			});
+
+		measure("Path::remove", count, [&]()
+			{
+				Path path(BENCH_REGISTRY_KEY);
+				path.remove(missingDir);
+			});
+
+		std::error_code ec;
+		std::filesystem::remove_all(shimDir, ec);
+	}
+}
+
+void Bench::generateConfig(size_t count) const
+{
+	std::ofstream file(workDir / std::to_string(count) / "shimmer.ini");
+	file << "[shimmer]\n";
+	for (size_t i = 0; i < count; ++i)
+	{
+		std::string alias = syntheticAlias(i);
+		file << alias << " = \"C:\\bench\\" << alias << ".exe\" | " << (i % 4 == 0 ? "Detached" : "Wait") << "\n";
+	}
+}
+
+void Bench::generatePath(size_t count) const
+{
+	// entries that do not exist, like the stale directories that pile up in a real PATH
+	std::string joined;
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (i > 0)
+		{
+			joined += ';';
+		}
+		joined += "C:\\bench\\path\\" + std::to_string(i);
+	}
+	Registry(BENCH_REGISTRY_KEY).write(BENCH_PATH_VALUE, joined);
+}
+
+void Bench::measure(const std::string& operation, size_t count, const std::function<void()>& body) const
+{
+	// I/O operation counts stand in for syscalls; Windows has no cheap per-process syscall counter
+	IO_COUNTERS before{};
+	IO_COUNTERS after{};
+	CountingBuffer console;
+
+	std::streambuf* original = std::cout.rdbuf(&console);
+	GetProcessIoCounters(GetCurrentProcess(), &before);
+	auto start = std::chrono::steady_clock::now();
+
+	body();
+
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	GetProcessIoCounters(GetCurrentProcess(), &after);
+	std::cout.rdbuf(original);
+
+	ULONGLONG ioOps =
+		(after.ReadOperationCount - before.ReadOperationCount) +
+		(after.WriteOperationCount - before.WriteOperationCount) +
+		(after.OtherOperationCount - before.OtherOperationCount);
+	ULONGLONG diskBytes = after.WriteTransferCount - before.WriteTransferCount;
+
+	std::cout << std::left
+		<< std::setw(16) << operation
+		<< std::setw(10) << count
+		<< std::setw(14) << std::fixed << std::setprecision(3)
+		<< std::chrono::duration<double, std::milli>(elapsed).count()
+		<< std::setw(12) << ioOps
+		<< std::setw(14) << diskBytes
+		<< console.count << std::endl;
+}
+
+} // namespace shim
@@ -0,0 +1,300 @@
+// doctor.cpp
+// Shimmer
+// author: beefviper
+// date: July 27, 2025
+
+#include "doctor.hpp"
+#include "json.hpp"
+#include "embed.hpp"
+
+#include <atomic>
+#include <cctype>
+#include <thread>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+#include <Windows.h>
+
+namespace shim
+{
+
+static std::string toLower(std::string str)
+{
+	std::transform(str.begin(), str.end(), str.begin(),
+		[](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return str;
+}
+
+static std::vector<std::string> executableExtensions()
+{
+	char buffer[1024];
+	DWORD length = GetEnvironmentVariableA("PATHEXT", buffer, sizeof(buffer));
+	std::string pathExt = (length > 0 && length < sizeof(buffer)) ? std::string(buffer, length) : ".COM;.EXE;.BAT;.CMD";
+
+	std::vector<std::string> extensions;
+	size_t start = 0;
+	while (start <= pathExt.size())
+	{
+		size_t end = pathExt.find(';', start);
+		if (end == std::string::npos)
+		{
+			end = pathExt.size();
+		}
+		if (end > start)
+		{
+			extensions.push_back(toLower(pathExt.substr(start, end - start)));
+		}
+		start = end + 1;
+	}
+	return extensions;
+}
+
+static bool sameContents(const std::filesystem::path& path, const std::vector<char>& image)
+{
+	// only the PE image counts; an embedded record after it is checked separately
+	if (imageSize(path) != image.size())
+	{
+		return false;
+	}
+
+	std::ifstream file(path, std::ios::binary);
+	std::vector<char> chunk(64 * 1024);
+	size_t offset = 0;
+	while (file && offset < image.size())
+	{
+		file.read(chunk.data(), static_cast<std::streamsize>((std::min)(chunk.size(), image.size() - offset)));
+		size_t got = static_cast<size_t>(file.gcount());
+		if (got == 0 || !std::equal(chunk.begin(), chunk.begin() + got, image.begin() + offset))
+		{
+			return false;
+		}
+		offset += got;
+	}
+	return offset == image.size();
+}
+
+Doctor::Doctor(const Ini& ini, const Path& paths) :
+	ini(ini),
+	paths(paths),
+	shims(ini.getShims()),
+	ruleStubs(ini.ruleStubs()),
+	shimDir(ini.getPath().parent_path())
+{
+}
+
+bool Doctor::run(ListFormat format) const
+{
+	std::vector<Finding> findings = checkFiles();
+
+	for (auto& finding : checkCollisions())
+	{
+		findings.push_back(std::move(finding));
+	}
+	for (auto& finding : checkChains())
+	{
+		findings.push_back(std::move(finding));
+	}
+	for (auto& finding : checkPath())
+	{
+		findings.push_back(std::move(finding));
+	}
+
+	std::stable_sort(findings.begin(), findings.end(),
+		[](const Finding& a, const Finding& b) { return a.alias < b.alias; });
+
+	report(findings, format);
+	return findings.empty();
+}
+
+std::vector<Finding> Doctor::checkFiles() const
+{
+	char exePathRaw[MAX_PATH];
+	GetModuleFileNameA(NULL, exePathRaw, MAX_PATH);
+
+	std::ifstream exeFile(exePathRaw, std::ios::binary);
+	std::vector<char> image((std::istreambuf_iterator<char>(exeFile)), std::istreambuf_iterator<char>());
+	image.resize(static_cast<size_t>(imageSize(exePathRaw)));
+
+	const std::vector<std::string> extensions = executableExtensions();
+
+	// stubs answered by a rule get the same target and stub checks as exact aliases
+	std::vector<Shim> targets = shims;
+	targets.insert(targets.end(), ruleStubs.begin(), ruleStubs.end());
+
+	// each check is a handful of stat/read calls, so thousands of entries are I/O latency bound;
+	// spread them over one worker per core, each keeping its own findings to avoid locking
+	size_t workerCount = (std::max)(1u, std::thread::hardware_concurrency());
+	workerCount = (std::min)(workerCount, (std::max)(size_t{ 1 }, targets.size()));
+
+	std::atomic<size_t> next{ 0 };
+	std::vector<std::vector<Finding>> results(workerCount);
+	std::vector<std::thread> workers;
+
+	for (size_t w = 0; w < workerCount; ++w)
+	{
+		workers.emplace_back([&, w]()
+			{
+				for (size_t i = next++; i < targets.size(); i = next++)
+				{
+					const Shim& shim = targets[i];
+					std::vector<Finding>& out = results[w];
+					std::error_code ec;
+
+					if (isPattern(shim.alias))
+					{
+						// a rule's target only exists once a name fills in its captures
+						size_t stars = std::count(shim.alias.begin(), shim.alias.end(), '*');
+						std::vector<std::string> captures(stars, "*");
+						std::string expanded = expandCaptures(shim.program, shim.alias, captures);
+						size_t brace = expanded.find('{');
+						while (brace != std::string::npos && !(brace + 1 < expanded.size() && std::isdigit(static_cast<unsigned char>(expanded[brace + 1]))))
+						{
+							brace = expanded.find('{', brace + 1);
+						}
+						if (brace != std::string::npos)
+						{
+							out.push_back({ shim.alias, "pattern-capture-unbound", shim.program });
+						}
+						continue;
+					}
+
+					std::filesystem::path target(shim.program);
+					if (!std::filesystem::is_regular_file(target, ec))
+					{
+						out.push_back({ shim.alias, "target-missing", shim.program });
+					}
+					else if (std::find(extensions.begin(), extensions.end(),
+						toLower(target.extension().string())) == extensions.end())
+					{
+						out.push_back({ shim.alias, "target-not-executable", shim.program });
+					}
+
+					std::filesystem::path stub = shimDir / (shim.alias + ".exe");
+					if (!std::filesystem::exists(stub, ec))
+					{
+						out.push_back({ shim.alias, "stub-missing", stub.string() });
+					}
+					else if (!sameContents(stub, image))
+					{
+						out.push_back({ shim.alias, "stub-outdated", stub.string() });
+					}
+					else
+					{
+						std::optional<Shim> embedded = readEmbedded(stub);
+						if (embedded.has_value() != shim.embed ||
+							(embedded && formatShimLine(*embedded) != formatShimLine(shim)))
+						{
+							out.push_back({ shim.alias, "stub-record-stale", stub.string() });
+						}
+					}
+				}
+			});
+	}
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+
+	std::vector<Finding> findings;
+	for (auto& result : results)
+	{
+		findings.insert(findings.end(), result.begin(), result.end());
+	}
+	return findings;
+}
+
+std::vector<Finding> Doctor::checkCollisions() const
+{
+	// Windows resolves git.exe and Git.exe to the same file, so these shadow each other
+	std::vector<std::pair<std::string, std::string>> folded;
+	for (const Shim& shim : shims)
+	{
+		folded.emplace_back(toLower(shim.alias), shim.alias);
+	}
+	std::sort(folded.begin(), folded.end());
+
+	std::vector<Finding> findings;
+	for (size_t i = 1; i < folded.size(); ++i)
+	{
+		if (folded[i].first == folded[i - 1].first)
+		{
+			findings.push_back({ folded[i].second, "alias-collision", folded[i - 1].second });
+		}
+	}
+	return findings;
+}
+
+std::vector<Finding> Doctor::checkChains() const
+{
+	// runs on this thread: Ini's lookup tables are built lazily and not safe to share with the file workers
+	std::vector<Finding> findings;
+	for (const Shim& shim : shims)
+	{
+		if (isPattern(shim.alias))
+		{
+			continue;
+		}
+
+		std::vector<std::string> via;
+		std::string resolved;
+		if (!ini.chain(shim, via, resolved))
+		{
+			findings.push_back({ shim.alias, "chain-cycle", formatChain(shim.alias, via) });
+		}
+		else if (via != shim.via || resolved != shim.resolved)
+		{
+			findings.push_back({ shim.alias, "chain-stale", formatChain(shim.alias, via) + (resolved.empty() ? "" : " -> " + resolved) });
+		}
+	}
+	return findings;
+}
+
+std::vector<Finding> Doctor::checkPath() const
+{
+	if (paths.contains(shimDir))
+	{
+		return {};
+	}
+	return { { "", "path-missing", shimDir.string() } };
+}
+
+void Doctor::report(const std::vector<Finding>& findings, ListFormat format) const
+{
+	std::string buffer;
+
+	if (format == ListFormat::Json)
+	{
+		buffer += "{\"shims\":" + std::to_string(shims.size()) + ",\"problems\":[";
+		for (size_t i = 0; i < findings.size(); ++i)
+		{
+			buffer += i == 0 ? "\n{\"alias\":" : ",\n{\"alias\":";
+			appendJsonString(buffer, findings[i].alias);
+			buffer += ",\"check\":\"" + findings[i].check + "\",\"detail\":";
+			appendJsonString(buffer, findings[i].detail);
+			buffer += "}";
+		}
+		buffer += findings.empty() ? "]}\n" : "\n]}\n";
+	}
+	else if (format == ListFormat::Tsv)
+	{
+		for (const Finding& finding : findings)
+		{
+			buffer += finding.alias + "\t" + finding.check + "\t" + finding.detail + "\n";
+		}
+	}
+	else
+	{
+		for (const Finding& finding : findings)
+		{
+			buffer += (finding.alias.empty() ? "shimmer" : finding.alias) + ": " + finding.check + ": " + finding.detail + "\n";
+		}
+		buffer += std::to_string(shims.size()) + " shims checked, " + std::to_string(findings.size()) + " problems found.\n";
+	}
+
+	std::cout.write(buffer.data(), buffer.size());
+	std::cout.flush();
+}
+
+} // namespace shim
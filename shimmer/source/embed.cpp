@@ -0,0 +1,117 @@
+// embed.cpp
+// Shimmer
+// author: beefviper
+// date: July 27, 2025
+
+#include "embed.hpp"
+
+#include <fstream>
+#include <algorithm>
+
+namespace shim
+{
+
+static constexpr char EMBED_MAGIC[8] = { 'S', 'H', 'I', 'M', 'R', 'E', 'C', '1' };
+static constexpr std::uint64_t FOOTER_SIZE = 16;
+static constexpr std::uint64_t MAX_RECORD_SIZE = 64 * 1024;
+
+static std::optional<std::string> readRecord(const std::filesystem::path& exe, std::uintmax_t& image)
+{
+	std::error_code ec;
+	std::uintmax_t size = std::filesystem::file_size(exe, ec);
+	image = ec ? 0 : size;
+	if (ec || size < FOOTER_SIZE)
+	{
+		return std::nullopt;
+	}
+
+	std::ifstream file(exe, std::ios::binary);
+	unsigned char footer[FOOTER_SIZE];
+	file.seekg(static_cast<std::streamoff>(size - FOOTER_SIZE));
+	if (!file.read(reinterpret_cast<char*>(footer), FOOTER_SIZE) ||
+		!std::equal(std::begin(EMBED_MAGIC), std::end(EMBED_MAGIC), reinterpret_cast<char*>(footer) + 8))
+	{
+		return std::nullopt;
+	}
+
+	std::uint64_t recordSize = 0;
+	for (int i = 7; i >= 0; --i)
+	{
+		recordSize = (recordSize << 8) | footer[i];
+	}
+	if (recordSize > MAX_RECORD_SIZE || recordSize + FOOTER_SIZE > size)
+	{
+		return std::nullopt;
+	}
+
+	std::string record(static_cast<size_t>(recordSize), '\0');
+	file.seekg(static_cast<std::streamoff>(size - FOOTER_SIZE - recordSize));
+	if (!file.read(record.data(), static_cast<std::streamsize>(recordSize)))
+	{
+		return std::nullopt;
+	}
+
+	image = size - FOOTER_SIZE - recordSize;
+	return record;
+}
+
+std::uintmax_t imageSize(const std::filesystem::path& exe)
+{
+	std::uintmax_t image = 0;
+	readRecord(exe, image);
+	return image;
+}
+
+std::optional<Shim> readEmbedded(const std::filesystem::path& exe)
+{
+	std::uintmax_t image = 0;
+	std::optional<std::string> record = readRecord(exe, image);
+	if (!record)
+	{
+		return std::nullopt;
+	}
+
+	Shim shim;
+	std::string error;
+	if (!parseShimLine(*record, shim, error))
+	{
+		return std::nullopt;
+	}
+	return shim;
+}
+
+bool stampStub(const std::filesystem::path& stub, const Shim& shim)
+{
+	// drop whatever trailer came along with the copy (e.g. when run from an embedded stub)
+	std::uintmax_t image = 0;
+	if (readRecord(stub, image))
+	{
+		std::error_code ec;
+		std::filesystem::resize_file(stub, image, ec);
+		if (ec)
+		{
+			return false;
+		}
+	}
+
+	if (!shim.embed)
+	{
+		return true;
+	}
+
+	std::string record = formatShimLine(shim);
+	char footer[FOOTER_SIZE];
+	std::uint64_t recordSize = record.size();
+	for (int i = 0; i < 8; ++i)
+	{
+		footer[i] = static_cast<char>((recordSize >> (8 * i)) & 0xFF);
+	}
+	std::copy(std::begin(EMBED_MAGIC), std::end(EMBED_MAGIC), footer + 8);
+
+	std::ofstream file(stub, std::ios::binary | std::ios::app);
+	file.write(record.data(), static_cast<std::streamsize>(record.size()));
+	file.write(footer, FOOTER_SIZE);
+	return static_cast<bool>(file.flush());
+}
+
+} // namespace shim
@@ -4,9 +4,14 @@
 // date: July 27, 2025
 
 #include "ini.hpp"
+#include "json.hpp"
+#include "embed.hpp"
+#include "shell.hpp"
 
 #include <iostream>
 #include <fstream>
+#include <iterator>
+#include <algorithm>
 
 namespace shim
 {
@@ -24,239 +29,1255 @@ static ShimMode praseMode(const std::string& modeStr)
 	{
 		return ShimMode::Detached;
 	}
+	if (modeStr == "Memo")
+	{
+		return ShimMode::Memo;
+	}
 
 	return ShimMode::Wait;
 }
 
-static std::string modeToString(ShimMode mode)
-{
-	return mode == ShimMode::Detached ? "Detached" : "Wait";
-}
+static std::string modeToString(ShimMode mode)
+{
+	switch (mode)
+	{
+	case ShimMode::Detached: return "Detached";
+	case ShimMode::Memo: return "Memo";
+	default: return "Wait";
+	}
+}
+
+static std::vector<std::string> split(const std::string& str, char delimiter)
+{
+	std::vector<std::string> parts;
+	size_t start = 0;
+	while (true)
+	{
+		size_t end = str.find(delimiter, start);
+		parts.push_back(trim(str.substr(start, end == std::string::npos ? std::string::npos : end - start)));
+		if (end == std::string::npos)
+		{
+			return parts;
+		}
+		start = end + 1;
+	}
+}
+
+static std::string formatModeAndOptions(const Shim& shim, const std::string& separator)
+{
+	std::string line = separator + modeToString(shim.mode);
+	for (const auto& [key, value] : shimOptions(shim))
+	{
+		line += separator + key + "=" + value;
+	}
+	return line;
+}
+
+static const std::vector<std::pair<Priority, std::string>> PRIORITY_NAMES{
+	{ Priority::Idle, "idle" },
+	{ Priority::BelowNormal, "below_normal" },
+	{ Priority::Normal, "normal" },
+	{ Priority::AboveNormal, "above_normal" },
+	{ Priority::High, "high" },
+	{ Priority::Realtime, "realtime" }
+};
+
+static const std::vector<std::pair<IoPriority, std::string>> IO_PRIORITY_NAMES{
+	{ IoPriority::VeryLow, "very_low" },
+	{ IoPriority::Low, "low" },
+	{ IoPriority::Normal, "normal" }
+};
+
+template <typename T>
+static bool lookupName(const std::vector<std::pair<T, std::string>>& names, const std::string& name, T& value)
+{
+	for (const auto& [candidate, candidateName] : names)
+	{
+		if (candidateName == name)
+		{
+			value = candidate;
+			return true;
+		}
+	}
+	return false;
+}
+
+template <typename T>
+static std::string nameOf(const std::vector<std::pair<T, std::string>>& names, T value)
+{
+	for (const auto& [candidate, candidateName] : names)
+	{
+		if (candidate == value)
+		{
+			return candidateName;
+		}
+	}
+	return {};
+}
+
+static bool parseCpuList(const std::string& list, std::uint64_t& mask)
+{
+	// "0,2-3" style, limited to what a process affinity mask can hold on this build
+	constexpr unsigned MAX_CPU = sizeof(DWORD_PTR) * 8 - 1;
+
+	mask = 0;
+	for (const std::string& part : split(list, ','))
+	{
+		auto dash = part.find('-');
+		unsigned long first = std::stoul(part.substr(0, dash));
+		unsigned long last = dash == std::string::npos ? first : std::stoul(part.substr(dash + 1));
+		if (first > last || last > MAX_CPU)
+		{
+			return false;
+		}
+
+		for (unsigned long cpu = first; cpu <= last; ++cpu)
+		{
+			mask |= std::uint64_t{ 1 } << cpu;
+		}
+	}
+	return mask != 0;
+}
+
+static std::string formatCpuList(std::uint64_t mask)
+{
+	std::string list;
+	for (unsigned cpu = 0; cpu < 64; ++cpu)
+	{
+		if (((mask >> cpu) & 1) == 0)
+		{
+			continue;
+		}
+
+		unsigned last = cpu;
+		while (last + 1 < 64 && ((mask >> (last + 1)) & 1))
+		{
+			++last;
+		}
+
+		list += (list.empty() ? "" : ",") + std::to_string(cpu);
+		if (last > cpu)
+		{
+			list += "-" + std::to_string(last);
+		}
+		cpu = last;
+	}
+	return list;
+}
+
+bool applyOption(Shim& shim, const std::string& option)
+{
+	auto eq = option.find('=');
+	if (eq == std::string::npos)
+	{
+		return false;
+	}
+
+	std::string key = trim(option.substr(0, eq));
+	std::string value = trim(option.substr(eq + 1));
+
+	try
+	{
+		if (key == "memo_env")
+		{
+			shim.memoEnv.clear();
+			for (const std::string& name : split(value, ','))
+			{
+				if (!name.empty())
+				{
+					shim.memoEnv.push_back(name);
+				}
+			}
+			return true;
+		}
+		if (key == "memo_cwd")
+		{
+			shim.memoCwd = value == "true";
+			return value == "true" || value == "false";
+		}
+		if (key == "memo_limit")
+		{
+			shim.memoLimit = std::stoull(value) * 1024 * 1024;
+			return true;
+		}
+		if (key == "max_concurrent")
+		{
+			// one named mutex per slot, and WaitForMultipleObjects takes at most 64 handles
+			unsigned long slots = std::stoul(value);
+			if (slots > MAXIMUM_WAIT_OBJECTS)
+			{
+				return false;
+			}
+			shim.maxConcurrent = static_cast<unsigned>(slots);
+			return true;
+		}
+		if (key == "max_wait")
+		{
+			shim.maxWait = std::stoul(value);
+			return true;
+		}
+		if (key == "affinity")
+		{
+			return parseCpuList(value, shim.affinity);
+		}
+		if (key == "priority")
+		{
+			return lookupName(PRIORITY_NAMES, value, shim.priority);
+		}
+		if (key == "io_priority")
+		{
+			return lookupName(IO_PRIORITY_NAMES, value, shim.ioPriority);
+		}
+		if (key == "embed")
+		{
+			shim.embed = value == "true";
+			return value == "true" || value == "false";
+		}
+		if (key == "via")
+		{
+			shim.via = split(value, ',');
+			return std::none_of(shim.via.begin(), shim.via.end(), [](const std::string& alias) { return alias.empty(); });
+		}
+		if (key == "resolved")
+		{
+			shim.resolved = value;
+			return !value.empty();
+		}
+	}
+	catch (const std::exception&)
+	{
+	}
+
+	return false;
+}
+
+std::vector<std::pair<std::string, std::string>> shimOptions(const Shim& shim)
+{
+	std::vector<std::pair<std::string, std::string>> options;
+
+	if (!shim.memoEnv.empty())
+	{
+		std::string names;
+		for (const std::string& name : shim.memoEnv)
+		{
+			names += (names.empty() ? "" : ",") + name;
+		}
+		options.emplace_back("memo_env", names);
+	}
+	if (!shim.memoCwd)
+	{
+		options.emplace_back("memo_cwd", "false");
+	}
+	if (shim.memoLimit != Shim{}.memoLimit)
+	{
+		options.emplace_back("memo_limit", std::to_string(shim.memoLimit / (1024 * 1024)));
+	}
+	if (shim.maxConcurrent != 0)
+	{
+		options.emplace_back("max_concurrent", std::to_string(shim.maxConcurrent));
+	}
+	if (shim.maxWait != 0)
+	{
+		options.emplace_back("max_wait", std::to_string(shim.maxWait));
+	}
+	if (shim.affinity != 0)
+	{
+		options.emplace_back("affinity", formatCpuList(shim.affinity));
+	}
+	if (shim.priority != Priority::Default)
+	{
+		options.emplace_back("priority", nameOf(PRIORITY_NAMES, shim.priority));
+	}
+	if (shim.ioPriority != IoPriority::Default)
+	{
+		options.emplace_back("io_priority", nameOf(IO_PRIORITY_NAMES, shim.ioPriority));
+	}
+	if (shim.embed)
+	{
+		options.emplace_back("embed", "true");
+	}
+	if (!shim.via.empty())
+	{
+		std::string aliases;
+		for (const std::string& alias : shim.via)
+		{
+			aliases += (aliases.empty() ? "" : ",") + alias;
+		}
+		options.emplace_back("via", aliases);
+	}
+	if (!shim.resolved.empty())
+	{
+		options.emplace_back("resolved", shim.resolved);
+	}
+
+	return options;
+}
+
+bool parseShimLine(const std::string& line, Shim& shim, std::string& error)
+{
+	auto eq = line.find('=');
+	if (eq == std::string::npos)
+	{
+		error = "Unable to find '=' in line.";
+		return false;
+	}
+
+	std::string alias = trim(line.substr(0, eq));
+	std::string rest = trim(line.substr(eq + 1));
+
+	if (rest.size() < 3 || rest[0] != '"')
+	{
+		error = "Unable to find opening quote in line.";
+		return false;
+	}
+
+	auto quoteEnd = rest.find('"', 1);
+	if (quoteEnd == std::string::npos)
+	{
+		error = "Unable to find closing quote in line.";
+		return false;
+	}
+
+	std::string program = rest.substr(1, quoteEnd - 1);
+	std::string tail = trim(rest.substr(quoteEnd + 1));
+	if (!tail.empty() && tail[0] == '|')
+	{
+		tail = trim(tail.substr(1));
+	}
+
+	if (alias.empty() || program.empty())
+	{
+		error = "Alias or program is empty.";
+		return false;
+	}
+
+	// "| Mode | key=value | key=value", where the mode may be omitted
+	shim = Shim{ alias, program };
+	std::vector<std::string> fields = split(tail, '|');
+	size_t first = 0;
+	if (fields[0].find('=') == std::string::npos)
+	{
+		shim.mode = praseMode(fields[0]);
+		first = 1;
+	}
+
+	for (size_t i = first; i < fields.size(); ++i)
+	{
+		if (!applyOption(shim, fields[i]))
+		{
+			error = "Unknown or malformed option: " + fields[i];
+			return false;
+		}
+	}
+
+	return true;
+}
+
+std::string formatShimLine(const Shim& shim)
+{
+	return shim.alias + " = \"" + shim.program + "\"" + formatModeAndOptions(shim, " | ");
+}
+
+std::string formatChain(const std::string& alias, const std::vector<std::string>& via)
+{
+	std::string chain = alias;
+	for (const std::string& hop : via)
+	{
+		chain += " -> " + hop;
+	}
+	return chain;
+}
+
+static bool hasLaunchPolicy(const Shim& shim)
+{
+	const Shim defaults;
+	return shim.mode != defaults.mode || shim.memoEnv != defaults.memoEnv || shim.memoCwd != defaults.memoCwd || shim.memoLimit != defaults.memoLimit ||
+		shim.maxConcurrent != defaults.maxConcurrent || shim.maxWait != defaults.maxWait ||
+		shim.affinity != defaults.affinity || shim.priority != defaults.priority || shim.ioPriority != defaults.ioPriority;
+}
+
+static bool isLockError(const std::error_code& ec)
+{
+	// only these mean the stub is in use; anything else would fail again after retiring it
+	return ec.category() == std::system_category() &&
+		(ec.value() == ERROR_SHARING_VIOLATION || ec.value() == ERROR_ACCESS_DENIED || ec.value() == ERROR_LOCK_VIOLATION);
+}
+
+static constexpr const char* REG_INSTALLPATH_VALUE = "InstalledPath";
+static constexpr const char* TOMBSTONE_DIR = ".tombstone";
+static constexpr size_t MAX_CHAIN = 32;
+
+Ini::Ini() :
+	Ini(std::filesystem::path{})
+{
+}
+
+Ini::Ini(const std::filesystem::path& basePath)
+{
+	std::filesystem::path baseDir = basePath.empty() ? std::filesystem::path(registry.read(REG_INSTALLPATH_VALUE)) : basePath;
+	if (baseDir.empty())
+	{
+		std::cerr << "Error: InstalledPath not found in registry. Shimmer must be installed first." << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+
+	iniPath = baseDir / "shimmer.ini";
+
+	// an explicit base path may not have an INI yet (--init, --batch before --install)
+	if (basePath.empty() || std::filesystem::exists(iniPath))
+	{
+		load();
+	}
+}
+
+Ini::~Ini()
+{
+	if (dirty && !deferred && !save())
+	{
+		std::cerr << "Error: Unable to open INI file for writing at " << iniPath << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+}
+
+std::vector<Shim> Ini::getShims() const
+{
+	return shims;
+}
+
+std::filesystem::path Ini::getPath() const
+{
+	return iniPath;
+}
+
+void Ini::setStubSource(const std::filesystem::path& source)
+{
+	stubSource = source;
+}
+	
+
+const Shim* Ini::find(const std::string& alias) const
+{
+	// sorting costs more than one scan, so a lookup only uses the index when it is already there
+	if (indexStale)
+	{
+		auto found = std::find_if(shims.begin(), shims.end(),
+			[&](const Shim& s)
+			{
+				return s.alias == alias;
+			}
+		);
+		return found == shims.end() ? nullptr : &*found;
+	}
+
+	const std::vector<size_t>& order = index;
+	auto it = std::lower_bound(order.begin(), order.end(), alias,
+		[&](size_t i, const std::string& key)
+		{
+			return shims[i].alias < key;
+		}
+	);
+
+	if (it == order.end() || shims[*it].alias != alias)
+	{
+		return nullptr;
+	}
+	return &shims[*it];
+}
+
+std::optional<Shim> Ini::resolve(const std::string& name) const
+{
+	std::optional<Shim> shim = lookup(name);
+	if (shim && !find(name))
+	{
+		// a rule's target is only known once expanded, so its chain cannot be flattened ahead of time
+		if (!chain(*shim, shim->via, shim->resolved))
+		{
+			shim->via.clear();
+		}
+	}
+	return shim;
+}
+
+bool Ini::chain(const Shim& shim, std::vector<std::string>& via, std::string& resolved) const
+{
+	via.clear();
+	resolved.clear();
+
+	// a hop with its own launch policy (mode, memo, admission, scheduling) has to run as itself,
+	// so resolution stops at its stub; the walk goes on only to find cycles
+	std::string program = shim.program;
+	std::optional<std::pair<size_t, std::string>> stop;
+	for (std::optional<std::string> next = stubAlias(program); next; next = stubAlias(program))
+	{
+		bool seen = _stricmp(next->c_str(), shim.alias.c_str()) == 0 || std::any_of(via.begin(), via.end(),
+			[&](const std::string& alias) { return _stricmp(alias.c_str(), next->c_str()) == 0; });
+		if (seen || via.size() == MAX_CHAIN)
+		{
+			via.push_back(*next);
+			return false;
+		}
+
+		std::optional<Shim> hop = lookup(*next);
+		if (!hop)
+		{
+			// a stub nobody answers for; launching it fails the same way with or without flattening
+			break;
+		}
+
+		if (!stop && hasLaunchPolicy(*hop))
+		{
+			stop.emplace(via.size(), program);
+		}
+		via.push_back(hop->alias);
+		program = hop->program;
+	}
+
+	if (stop)
+	{
+		via.resize(stop->first);
+		program = stop->second;
+	}
+	if (!via.empty())
+	{
+		resolved = program;
+	}
+	return true;
+}
+
+std::optional<Shim> Ini::lookup(const std::string& name) const
+{
+	// exact aliases always win over pattern rules
+	if (const Shim* exact = find(name))
+	{
+		return *exact;
+	}
+
+	std::optional<size_t> rule = patternMatcher().match(name);
+	std::vector<std::string> captures;
+	if (!rule || !matchCaptures(shims[patternRules[*rule]].alias, name, captures))
+	{
+		return std::nullopt;
+	}
+
+	Shim shim = shims[patternRules[*rule]];
+	shim.alias = name;
+	shim.program = expandCaptures(shim.program, name, captures);
+	return shim;
+}
+
+bool Ini::add(const Shim& shim)
+{
+	if (find(shim.alias))
+	{
+		return false;
+	}
+
+	Shim flat = shim;
+	if (!isPattern(flat.alias) && !chain(flat, flat.via, flat.resolved))
+	{
+		std::cerr << "Error: Shim chain cycle: " << formatChain(flat.alias, flat.via) << std::endl;
+		return false;
+	}
+
+	if (isPattern(shim.alias))
+	{
+		// a rule has no stub of its own; it answers for stubs named after the names it matches
+	}
+	else if (deferred)
+	{
+		staged.push_back(shim.alias);
+	}
+	else
+	{
+		std::filesystem::path exePath = stubImage();
+
+		std::filesystem::path newShim = iniPath.parent_path() / (shim.alias + ".exe");
+		try {
+			std::filesystem::copy_file(exePath, newShim, std::filesystem::copy_options::overwrite_existing);
+		}
+		catch (const std::filesystem::filesystem_error& e) {
+			MessageBoxA(NULL, e.what(), "Copy Failed", MB_OK | MB_ICONERROR);
+			return 1;
+		}
+
+		if (!stampStub(newShim, flat))
+		{
+			MessageBoxA(NULL, ("Failed to embed record in: " + newShim.string()).c_str(), "Copy Failed", MB_OK | MB_ICONERROR);
+		}
+	}
+
+	shims.push_back(flat);
+	if (!indexStale)
+	{
+		auto position = std::upper_bound(index.begin(), index.end(), flat.alias,
+			[&](const std::string& key, size_t i)
+			{
+				return key < shims[i].alias;
+			}
+		);
+		index.insert(position, shims.size() - 1);
+	}
+	matcherStale = true;
+	dirty = true;
+
+	// shims that pointed at this alias's stub now launch its target directly
+	if (!deferred)
+	{
+		restamp(flatten());
+	}
+	return true;
+}
+
+bool Ini::addRuleStub(const std::string& name)
+{
+	// an exact alias already has its own stub, and a rule needs a concrete name to answer for
+	if (find(name) || isPattern(name))
+	{
+		std::cerr << "Error: " << name << " is not a name for a pattern rule." << std::endl;
+		return false;
+	}
+
+	std::optional<Shim> shim = resolve(name);
+	if (!shim)
+	{
+		std::cerr << "Error: No pattern rule matches " << name << std::endl;
+		return false;
+	}
+
+	std::filesystem::path stub = iniPath.parent_path() / (name + ".exe");
+	std::error_code ec;
+	std::filesystem::copy_file(stubImage(), stub, std::filesystem::copy_options::overwrite_existing, ec);
+	if (ec || !stampStub(stub, *shim))
+	{
+		std::cerr << "Error: Unable to create stub " << stub << ": " << ec.message() << std::endl;
+		return false;
+	}
+
+	std::cout << "Created stub: " << name << " -> " << shim->program << std::endl;
+	return true;
+}
+
+std::vector<Shim> Ini::ruleStubs() const
+{
+	std::vector<Shim> matched;
+	if (std::none_of(shims.begin(), shims.end(), [](const Shim& shim) { return isPattern(shim.alias); }))
+	{
+		return matched;
+	}
+
+	// stubs created with --stub have no line of their own; the rule that answers for them is their record
+	std::error_code ec;
+	for (const auto& entry : std::filesystem::directory_iterator(iniPath.parent_path(), ec))
+	{
+		std::string extension = entry.path().extension().string();
+		std::string stem = entry.path().stem().string();
+		if (_stricmp(extension.c_str(), ".exe") != 0 || _stricmp(stem.c_str(), "shimmer") == 0 || find(stem))
+		{
+			continue;
+		}
+
+		if (std::optional<Shim> shim = resolve(stem))
+		{
+			matched.push_back(std::move(*shim));
+		}
+	}
+	return matched;
+}
+
+bool Ini::remove(const std::string& alias)
+{
+	std::filesystem::path shimExePath = iniPath.parent_path() / (alias + ".exe");
+
+	char exePathRaw[MAX_PATH];
+	GetModuleFileNameA(NULL, exePathRaw, MAX_PATH);
+	std::filesystem::path currentExePath(exePathRaw);
+
+	if (_stricmp(shimExePath.filename().string().c_str(), "shimmer.exe") == 0 &&
+		std::filesystem::equivalent(shimExePath, currentExePath))
+	{
+		MessageBoxA(NULL, "Cannot remove shimmer itself.", "Remove Failed", MB_OK | MB_ICONERROR);
+		return false;
+	}
+
+	std::error_code ec;
+	if (!deferred && !isPattern(alias))
+	{
+		std::filesystem::remove(shimExePath, ec);
+	}
+
+	if (ec)
+	{
+		// a running stub (this process or another instance) cannot be deleted,
+		// but it can still be renamed out of the way and reaped later
+		if (retire(shimExePath).empty())
+		{
+			std::string msg = "Failed to delete shim file: " + shimExePath.string() + "\n" + ec.message();
+			MessageBoxA(NULL, msg.c_str(), "Delete Failed", MB_OK | MB_ICONERROR);
+		}
+	}
+
+	auto it = std::find_if(shims.begin(), shims.end(),
+		[&](const Shim& s)
+		{
+			return s.alias == alias;
+		}
+	);
+
+	if (it == shims.end())
+	{
+		return false;
+	}
 
-static constexpr const char* REG_INSTALLPATH_VALUE = "InstalledPath";
+	// aliases are unique, so exactly one entry goes; later positions shift down by one
+	size_t erased = static_cast<size_t>(it - shims.begin());
+	shims.erase(it);
+	if (!indexStale)
+	{
+		index.erase(std::find(index.begin(), index.end(), erased));
+		for (size_t& position : index)
+		{
+			position -= position > erased ? 1 : 0;
+		}
+	}
+	matcherStale = true;
+	dirty = true;
 
-Ini::Ini() :
-	Ini(registry.read(REG_INSTALLPATH_VALUE))
-{
+	if (!deferred)
+	{
+		restamp(flatten());
+	}
+	return true;
 }
 
-Ini::Ini(const std::filesystem::path& basePath)
+void Ini::begin()
 {
-	std::filesystem::path regInstalledPath = registry.read(REG_INSTALLPATH_VALUE);
-	if (regInstalledPath.empty() && basePath.empty())
+	deferred = true;
+	staged.clear();
+	committedAliases.clear();
+	for (const Shim& shim : shims)
 	{
-		std::cerr << "Error: InstalledPath not found in registry. Shimmer must be installed first." << std::endl;
-		std::exit(EXIT_FAILURE);
+		committedAliases.push_back(shim.alias);
 	}
-	else if (!regInstalledPath.empty() && basePath.empty())
-	{
-		iniPath = regInstalledPath / "shimmer.ini";
+}
 
-		std::ifstream iniFile(iniPath);
-		if (!iniFile)
+bool Ini::commit()
+{
+	// stays deferred until everything is in place, so a failed batch is never saved on destruction
+	auto isLive = [&](const std::string& alias)
 		{
-			std::cerr << "Error: Unable to open INI file at " << iniPath << std::endl;
-			std::exit(EXIT_FAILURE);
-		}
+			return std::any_of(shims.begin(), shims.end(), [&](const Shim& s) { return s.alias == alias; });
+		};
 
-		std::string line;
-		while (std::getline(iniFile, line))
+	std::filesystem::path baseDir = iniPath.parent_path();
+	std::filesystem::path currentExePath = stubImage();
+
+	// every rename applied so far, undone in reverse if a later step fails
+	std::vector<std::pair<std::filesystem::path, std::filesystem::path>> journal;
+	std::vector<std::filesystem::path> pending;
+
+	auto rollback = [&](const std::string& what, const std::filesystem::path& path, const std::error_code& ec)
 		{
-			line = trim(line);
-			if (line.empty() || line[0] == '[' || line[0] == '#')
+			std::cerr << "Error: Batch aborted, " << what << " " << path << ": " << ec.message() << std::endl;
+
+			std::error_code undoEc;
+			for (auto it = journal.rbegin(); it != journal.rend(); ++it)
 			{
-				continue;
+				std::filesystem::rename(it->second, it->first, undoEc);
 			}
-
-			auto eq = line.find('=');
-			if (eq == std::string::npos)
+			for (const auto& temp : pending)
 			{
-				std::cerr << "Error: Invalid line in INI file: " << line << std::endl;
-				std::cerr << "\tUnable to find '=' in line." << std::endl;
-				exit(EXIT_FAILURE);
+				std::filesystem::remove(temp, undoEc);
 			}
+			return false;
+		};
 
-			std::string alias = trim(line.substr(0, eq));
-			std::string rest = trim(line.substr(eq + 1));
+	// chains are settled once for the whole batch; embedded records that changed need fresh stubs too
+	for (const std::string& alias : flatten())
+	{
+		const Shim* shim = find(alias);
+		if (shim && shim->embed)
+		{
+			staged.push_back(alias);
+		}
+	}
 
-			if (rest.size() < 3 || rest[0] != '"')
-			{
-				std::cerr << "Error: Invalid line in INI file: " << line << std::endl;
-				std::cerr << "\tUnable to find opening quote in line." << std::endl;
-				exit(EXIT_FAILURE);
-			}
+	// copy new stubs beside their final names first, so a failed copy leaves every live stub untouched
+	std::error_code ec;
+	for (const std::string& alias : staged)
+	{
+		std::filesystem::path temp = baseDir / (alias + ".exe.pending");
+		if (!isLive(alias) || std::find(pending.begin(), pending.end(), temp) != pending.end())
+		{
+			continue;
+		}
 
-			auto quoteEnd = rest.find('"', 1);
-			if (quoteEnd == std::string::npos)
-			{
-				std::cerr << "Error: Invalid line in INI file: " << line << std::endl;
-				std::cerr << "\tUnable to find closing quote in line." << std::endl;
-				exit(EXIT_FAILURE);
-			}
+		pending.push_back(temp);
+		std::filesystem::copy_file(currentExePath, temp, std::filesystem::copy_options::overwrite_existing, ec);
+		if (ec)
+		{
+			return rollback("unable to copy stub", temp, ec);
+		}
+		if (!stampStub(temp, *find(alias)))
+		{
+			return rollback("unable to embed record in", temp, std::make_error_code(std::errc::io_error));
+		}
+	}
 
-			std::string program = rest.substr(1, quoteEnd - 1);
-			std::string modeStr = trim(rest.substr(quoteEnd + 1));
-			if (!modeStr.empty() && modeStr[0] == '|')
-			{
-				modeStr = trim(modeStr.substr(1));
-			}
+	// move every stub being removed or replaced into the tombstone area; a rename also works on running stubs
+	std::vector<std::string> outgoing = staged;
+	for (const std::string& alias : committedAliases)
+	{
+		if (!isLive(alias) && !isPattern(alias))
+		{
+			outgoing.push_back(alias);
+		}
+	}
 
-			if (!alias.empty() && !program.empty())
-			{
-				shims.emplace_back(alias, program, praseMode(modeStr));
-			}
-			else
-			{
-				std::cerr << "Error: Invalid line in INI file: " << line << std::endl;
-				std::cerr << "\tAlias or program is empty." << std::endl;
-				exit(EXIT_FAILURE);
-			}
+	for (const std::string& alias : outgoing)
+	{
+		std::filesystem::path stub = baseDir / (alias + ".exe");
+		if (!std::filesystem::exists(stub, ec))
+		{
+			continue;
 		}
-		iniFile.close();
+
+		std::filesystem::path tombstone = retire(stub);
+		if (tombstone.empty())
+		{
+			return rollback("unable to retire stub", stub, std::make_error_code(std::errc::permission_denied));
+		}
+		journal.emplace_back(stub, tombstone);
 	}
-	else
+
+	for (const auto& temp : pending)
+	{
+		std::filesystem::path stub = baseDir / temp.stem();
+		std::filesystem::rename(temp, stub, ec);
+		if (ec)
+		{
+			return rollback("unable to place stub", stub, ec);
+		}
+		journal.emplace_back(temp, stub);
+	}
+
+	if (!save())
 	{
-		iniPath = regInstalledPath / "shimmer.ini";
+		return rollback("unable to write", iniPath, std::make_error_code(std::errc::io_error));
 	}
+
+	staged.clear();
+	committedAliases.clear();
+	deferred = false;
+	dirty = false;
+	return true;
 }
 
-Ini::~Ini()
+void Ini::load()
 {
-	if (!shims.empty())
+	std::ifstream iniFile(iniPath);
+	if (!iniFile)
+	{
+		std::cerr << "Error: Unable to open INI file at " << iniPath << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+
+	std::string line;
+	while (std::getline(iniFile, line))
 	{
-		std::ofstream file(iniPath);
+		line = trim(line);
+		if (line.empty() || line[0] == '[' || line[0] == '#')
+		{
+			continue;
+		}
+
+		Shim shim;
+		std::string error;
+		if (!parseShimLine(line, shim, error))
+		{
+			std::cerr << "Error: Invalid line in INI file: " << line << std::endl;
+			std::cerr << "\t" << error << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		shims.push_back(std::move(shim));
+	}
+	iniFile.close();
+
+	adoptIndex();
+	reap();
+}
+
+bool Ini::save() const
+{
+	// write beside the live file and swap it in, so a failed write never truncates shimmer.ini
+	std::filesystem::path tempPath = iniPath;
+	tempPath += ".tmp";
 
+	{
+		std::ofstream file(tempPath);
 		if (!file)
 		{
-			std::cerr << "Error: Unable to open INI file for writing at " << iniPath << std::endl;
-			std::exit(EXIT_FAILURE);
+			return false;
 		}
 
+		// exact aliases in alias order so the next load gets its index from one pass; rules keep their
+		// relative order after them, since the first matching rule wins
 		file << "[shimmer]\n";
+		for (size_t i : sortedIndex())
+		{
+			if (!isPattern(shims[i].alias))
+			{
+				file << formatShimLine(shims[i]) << "\n";
+			}
+		}
 		for (const Shim& shim : shims)
 		{
-			file << shim.alias << " = \"" << shim.program << "\" | " << modeToString(shim.mode) << "\n";
+			if (isPattern(shim.alias))
+			{
+				file << formatShimLine(shim) << "\n";
+			}
+		}
+
+		if (!file.flush())
+		{
+			return false;
 		}
 	}
+
+	std::error_code ec;
+	std::filesystem::rename(tempPath, iniPath, ec);
+	if (ec)
+	{
+		return false;
+	}
+
+	refreshShellScripts(shims, iniPath.parent_path());
+	saveMatcher();
+	return true;
 }
 
-std::vector<Shim> Ini::getShims() const
+std::filesystem::path Ini::stubImage() const
 {
-	return shims;
+	if (!stubSource.empty())
+	{
+		return stubSource;
+	}
+
+	char exePathRaw[MAX_PATH];
+	GetModuleFileNameA(NULL, exePathRaw, MAX_PATH);
+	return std::filesystem::path(exePathRaw);
 }
 
-std::filesystem::path Ini::getPath() const
+void Ini::adoptIndex()
 {
-	return iniPath;
+	// a file written by save() lists exact aliases in order, so checking that is all it takes;
+	// only the few rules need sorting before the two runs are merged
+	std::vector<size_t> exact;
+	std::vector<size_t> rules;
+	for (size_t i = 0; i < shims.size(); ++i)
+	{
+		(isPattern(shims[i].alias) ? rules : exact).push_back(i);
+	}
+
+	auto byAlias = [&](size_t a, size_t b)
+		{
+			return shims[a].alias < shims[b].alias;
+		};
+	if (!std::is_sorted(exact.begin(), exact.end(), byAlias))
+	{
+		return;
+	}
+
+	std::sort(rules.begin(), rules.end(), byAlias);
+	index.resize(shims.size());
+	std::merge(exact.begin(), exact.end(), rules.begin(), rules.end(), index.begin(), byAlias);
+	indexStale = false;
 }
-	
 
-bool Ini::add(const Shim& shim)
+const std::vector<size_t>& Ini::sortedIndex() const
 {
-	auto it = std::find_if(shims.begin(), shims.end(),
-		[&](const Shim& s)
+	if (indexStale)
+	{
+		index.resize(shims.size());
+		for (size_t i = 0; i < shims.size(); ++i)
 		{
-			return s.alias == shim.alias;
+			index[i] = i;
 		}
-	);
 
-	if (it != shims.end())
-	{
-		return false;
+		std::sort(index.begin(), index.end(),
+			[&](size_t a, size_t b)
+			{
+				return shims[a].alias < shims[b].alias;
+			}
+		);
+		indexStale = false;
 	}
 
-	char exePathRaw[MAX_PATH];
-	GetModuleFileNameA(NULL, exePathRaw, MAX_PATH);
-	std::filesystem::path exePath(exePathRaw);
+	return index;
+}
 
-	std::filesystem::path newShim = iniPath.parent_path() / (shim.alias + ".exe");
-	try {
-		std::filesystem::copy_file(exePath, newShim, std::filesystem::copy_options::overwrite_existing);
+std::vector<std::string> Ini::collectPatterns() const
+{
+	patternRules.clear();
+	std::vector<std::string> patterns;
+	for (size_t i = 0; i < shims.size(); ++i)
+	{
+		if (isPattern(shims[i].alias))
+		{
+			patternRules.push_back(i);
+			patterns.push_back(shims[i].alias);
+		}
 	}
-	catch (const std::filesystem::filesystem_error& e) {
-		MessageBoxA(NULL, e.what(), "Copy Failed", MB_OK | MB_ICONERROR);
-		return 1;
+	return patterns;
+}
+
+const PatternMatcher& Ini::patternMatcher() const
+{
+	if (matcherStale)
+	{
+		// the tables were compiled by the last save(); a missing or mismatched file (hand edits
+		// since, or unsaved changes in this process) leaves the matcher trying each rule in order
+		std::vector<std::string> patterns = collectPatterns();
+		matcher = PatternMatcher(patterns);
+		if (!patterns.empty())
+		{
+			matcher.load(matcherPath());
+		}
+		matcherStale = false;
 	}
 
-	shims.push_back(shim);
-	return true;
+	return matcher;
 }
 
-bool Ini::remove(const std::string& alias)
+std::filesystem::path Ini::matcherPath() const
 {
-	std::filesystem::path shimExePath = iniPath.parent_path() / (alias + ".exe");
+	std::filesystem::path path = iniPath;
+	path.replace_extension(".dfa");
+	return path;
+}
 
-	char exePathRaw[MAX_PATH];
-	GetModuleFileNameA(NULL, exePathRaw, MAX_PATH);
-	std::filesystem::path currentExePath(exePathRaw);
+void Ini::saveMatcher() const
+{
+	std::vector<std::string> patterns = collectPatterns();
+	std::filesystem::path path = matcherPath();
+	std::filesystem::path tempPath = path;
+	tempPath += ".tmp";
 
-	if (_stricmp(shimExePath.filename().string().c_str(), "shimmer.exe") == 0 &&
-		std::filesystem::equivalent(shimExePath, currentExePath))
+	std::error_code ec;
+	matcher = PatternMatcher(patterns);
+	matcherStale = false;
+	if (patterns.empty())
 	{
-		MessageBoxA(NULL, "Cannot remove shimmer itself.", "Remove Failed", MB_OK | MB_ICONERROR);
-		return false;
+		std::filesystem::remove(path, ec);
+		return;
+	}
+
+	matcher.compile();
+	if (!matcher.save(tempPath))
+	{
+		std::filesystem::remove(tempPath, ec);
+		std::filesystem::remove(path, ec);
+		return;
 	}
+	std::filesystem::rename(tempPath, path, ec);
+}
 
-	if (std::filesystem::equivalent(shimExePath, currentExePath))
+std::optional<std::string> Ini::stubAlias(const std::string& program) const
+{
+	// a program is another shim when it names an .exe (or bare name) directly in the shim directory;
+	// compared lexically so flattening never touches the disk
+	std::filesystem::path path(program);
+	std::string extension = path.extension().string();
+	if (!extension.empty() && _stricmp(extension.c_str(), ".exe") != 0)
 	{
-		std::string cmd =
-			"cmd.exe /C \""
-			"ping -n 3 127.0.0.1 > nul && "
-			"del /F /Q \"" + shimExePath.string() + "\"\"";
+		return std::nullopt;
+	}
 
-		STARTUPINFOA si = { sizeof(si) };
-		PROCESS_INFORMATION pi;
-		if (!CreateProcessA(NULL, cmd.data(), NULL, NULL, FALSE, CREATE_NO_WINDOW, NULL, NULL, &si, &pi)) {
-			std::string msg = "Failed to schedule deletion of: " + shimExePath.string();
-			MessageBoxA(NULL, msg.c_str(), "Delete Failed", MB_OK | MB_ICONERROR);
-		}
-		else {
-			CloseHandle(pi.hProcess);
-			CloseHandle(pi.hThread);
+	if (path.has_parent_path())
+	{
+		std::string dir = path.parent_path().lexically_normal().string();
+		std::string shimDir = iniPath.parent_path().lexically_normal().string();
+		auto strip = [](std::string& str)
+			{
+				while (str.size() > 1 && (str.back() == '\\' || str.back() == '/'))
+				{
+					str.pop_back();
+				}
+			};
+		strip(dir);
+		strip(shimDir);
+		if (_stricmp(dir.c_str(), shimDir.c_str()) != 0)
+		{
+			return std::nullopt;
 		}
 	}
-	else
+
+	std::string stem = path.stem().string();
+	if (_stricmp(stem.c_str(), "shimmer") == 0)
 	{
-		std::error_code ec;
-		std::filesystem::remove(shimExePath, ec);
-		if (ec) {
-			std::string msg = "Failed to delete shim file: " + shimExePath.string() + "\n" + ec.message();
-			MessageBoxA(NULL, msg.c_str(), "Delete Failed", MB_OK | MB_ICONERROR);
+		return std::nullopt;
+	}
+	return stem;
+}
+
+std::vector<std::string> Ini::flatten()
+{
+	std::vector<std::string> changed;
+	for (Shim& shim : shims)
+	{
+		if (isPattern(shim.alias))
+		{
+			continue;
+		}
+
+		std::vector<std::string> via;
+		std::string resolved;
+		if (!chain(shim, via, resolved))
+		{
+			std::cerr << "Error: Shim chain cycle: " << formatChain(shim.alias, via) << std::endl;
+		}
+
+		if (via != shim.via || resolved != shim.resolved)
+		{
+			shim.via = std::move(via);
+			shim.resolved = std::move(resolved);
+			changed.push_back(shim.alias);
+			dirty = true;
 		}
 	}
+	return changed;
+}
 
-	auto it = std::remove_if(shims.begin(), shims.end(),
-		[&](const Shim& s)
+void Ini::restamp(const std::vector<std::string>& aliases) const
+{
+	for (const std::string& alias : aliases)
+	{
+		const Shim* shim = find(alias);
+		std::filesystem::path stub = iniPath.parent_path() / (alias + ".exe");
+		if (shim && shim->embed && !stampStub(stub, *shim))
 		{
-			return s.alias == alias;
+			std::cerr << "Error: Unable to embed record in " << stub << std::endl;
 		}
-	);
+	}
+}
 
-	if (it == shims.end())
+std::filesystem::path Ini::retire(const std::filesystem::path& stubPath) const
+{
+	std::filesystem::path tombstoneDir = iniPath.parent_path() / TOMBSTONE_DIR;
+	std::filesystem::path tombstone = tombstoneDir /
+		(stubPath.stem().string() + "." + std::to_string(GetCurrentProcessId()) + "." +
+			std::to_string(GetTickCount64()) + ".exe");
+
+	std::error_code ec;
+	std::filesystem::create_directory(tombstoneDir, ec);
+	std::filesystem::rename(stubPath, tombstone, ec);
+	return ec ? std::filesystem::path{} : tombstone;
+}
+
+void Ini::reap() const
+{
+	std::filesystem::path tombstoneDir = iniPath.parent_path() / TOMBSTONE_DIR;
+
+	std::error_code ec;
+	if (!std::filesystem::exists(tombstoneDir, ec))
 	{
-		return false;
+		return;
 	}
 
-	shims.erase(it, shims.end());
-	return true;
+	bool empty = true;
+	for (const auto& entry : std::filesystem::directory_iterator(tombstoneDir, ec))
+	{
+		std::error_code removeEc;
+		if (!std::filesystem::remove(entry.path(), removeEc))
+		{
+			// still held open by a shim that has not exited yet
+			empty = false;
+		}
+	}
+
+	if (empty)
+	{
+		std::filesystem::remove(tombstoneDir, ec);
+	}
 }
 
-void Ini::list() const
+void Ini::list(const ListFilter& filter) const
 {
-	if (shims.empty())
+	if (shims.empty() && filter.format == ListFormat::Text)
 	{
 		std::cout << "No shims registered." << std::endl;
+		return;
 	}
-	else
+
+	// all aliases sharing the prefix sit next to each other in the sorted index
+	const std::vector<size_t>& order = sortedIndex();
+	auto it = std::lower_bound(order.begin(), order.end(), filter.prefix,
+		[&](size_t i, const std::string& key)
+		{
+			return shims[i].alias < key;
+		}
+	);
+
+	static constexpr size_t FLUSH_THRESHOLD = 64 * 1024;
+	std::string buffer;
+	bool first = true;
+
+	if (filter.format == ListFormat::Json)
+	{
+		buffer += "[";
+	}
+
+	for (; it != order.end() && shims[*it].alias.compare(0, filter.prefix.size(), filter.prefix) == 0; ++it)
 	{
-		for (const auto& shim : shims)
+		const Shim& shim = shims[*it];
+		if (filter.mode && shim.mode != *filter.mode)
 		{
-			std::cout << shim.alias << " = " << shim.program << " | " << (shim.mode == ShimMode::Detached ? "Detached" : "Wait") << std::endl;
+			continue;
+		}
+
+		switch (filter.format)
+		{
+		case ListFormat::Text:
+			buffer += shim.alias + " = " + shim.program + formatModeAndOptions(shim, " | ") + "\n";
+			break;
+		case ListFormat::Tsv:
+			buffer += shim.alias + "\t" + shim.program + formatModeAndOptions(shim, "\t") + "\n";
+			break;
+		case ListFormat::Json:
+			buffer += first ? "\n" : ",\n";
+			buffer += "{\"alias\":";
+			appendJsonString(buffer, shim.alias);
+			buffer += ",\"program\":";
+			appendJsonString(buffer, shim.program);
+			buffer += ",\"mode\":\"" + modeToString(shim.mode) + "\",\"options\":{";
+			for (const auto& [key, value] : shimOptions(shim))
+			{
+				buffer += buffer.back() == '{' ? "\"" : ",\"";
+				buffer += key + "\":";
+				appendJsonString(buffer, value);
+			}
+			buffer += "}}";
+			break;
+		}
+		first = false;
+
+		if (buffer.size() >= FLUSH_THRESHOLD)
+		{
+			std::cout.write(buffer.data(), buffer.size());
+			buffer.clear();
 		}
 	}
+
+	if (filter.format == ListFormat::Json)
+	{
+		buffer += first ? "]\n" : "\n]\n";
+	}
+
+	std::cout.write(buffer.data(), buffer.size());
+	std::cout.flush();
 }
 
-void Ini::rebuild() const
+void Ini::rebuild()
 {
 	if (shims.empty())
 	{
@@ -264,26 +1285,63 @@ void Ini::rebuild() const
 		return;
 	}
 
-	char exePathRaw[MAX_PATH];
-	GetModuleFileNameA(NULL, exePathRaw, MAX_PATH);
-	std::filesystem::path currentExePath(exePathRaw);
+	// picks up chains and rules changed by hand edits; every stub is re-stamped below anyway
+	flatten();
+	saveMatcher();
 
-	for (const Shim& shim : shims)
+	std::filesystem::path currentExePath = stubImage();
+
+	// every exact alias, plus each stub in the directory that only a rule answers for
+	std::vector<Shim> targets;
+	std::copy_if(shims.begin(), shims.end(), std::back_inserter(targets),
+		[](const Shim& shim) { return !isPattern(shim.alias); });
+	for (Shim& shim : ruleStubs())
+	{
+		targets.push_back(std::move(shim));
+	}
+
+	for (const Shim& shim : targets)
 	{
 		std::filesystem::path targetPath = iniPath.parent_path() / (shim.alias + ".exe");
-		try
+
+		std::error_code ec;
+		if (std::filesystem::equivalent(currentExePath, targetPath, ec))
+		{
+			// rebuilding from this stub: it is the source image for every other stub, so leave it alone
+			std::cout << "Skipped shim: " << shim.alias << " (running stub)" << std::endl;
+			continue;
+		}
+
+		ec.clear();
+		std::filesystem::copy_file(currentExePath, targetPath, std::filesystem::copy_options::overwrite_existing, ec);
+		if (ec && isLockError(ec))
+		{
+			// the old stub is held open by a running instance; move it to the tombstone area and try once more
+			std::filesystem::path tombstone = retire(targetPath);
+			if (!tombstone.empty())
+			{
+				std::filesystem::copy_file(currentExePath, targetPath, std::filesystem::copy_options::overwrite_existing, ec);
+				if (ec)
+				{
+					std::error_code undoEc;
+					std::filesystem::rename(tombstone, targetPath, undoEc);
+				}
+			}
+		}
+
+		if (!ec && !stampStub(targetPath, shim))
 		{
-			std::filesystem::copy_file(
-				currentExePath,
-				targetPath,
-				std::filesystem::copy_options::overwrite_existing
-			);
-			std::cout << "Rebuilt shim: " << shim.alias << " -> " << targetPath << std::endl;
+			ec = std::make_error_code(std::errc::io_error);
 		}
-		catch (const std::filesystem::filesystem_error& e)
+
+		if (ec)
 		{
+			std::filesystem::filesystem_error e("copy_file", currentExePath, targetPath, ec);
 			MessageBoxA(NULL, e.what(), "Rebuild Failed", MB_OK | MB_ICONERROR);
+			continue;
 		}
+
+		std::cout << "Rebuilt shim: " << shim.alias << " -> " << targetPath << std::endl;
 	}
 }
 
@@ -300,6 +1358,7 @@ void Ini::writeDefault() const
 	file << "[shimmer]\n";
 	file << "# git = \"C:\\Program Files\\Git\\bin\\git.exe\" | wait\n";
 	file << "# dolphin = \"c:\\progs\\emu\\dolphin\\dolphin.exe\" | detached\n";
+	file << "# clang-* = \"C:\\llvm\\{1}\\bin\\clang.exe\"\n";
 }
 
 } // namespace shim
@@ -0,0 +1,41 @@
+// json.cpp
+// Shimmer
+// author: beefviper
+// date: July 27, 2025
+
+#include "json.hpp"
+
+namespace shim
+{
+
+void appendJsonString(std::string& out, const std::string& value)
+{
+	static constexpr const char* HEX = "0123456789abcdef";
+
+	out += '"';
+	for (char c : value)
+	{
+		switch (c)
+		{
+		case '"': out += "\\\""; break;
+		case '\\': out += "\\\\"; break;
+		case '\n': out += "\\n"; break;
+		case '\r': out += "\\r"; break;
+		case '\t': out += "\\t"; break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20)
+			{
+				out += "\\u00";
+				out += HEX[(c >> 4) & 0xF];
+				out += HEX[c & 0xF];
+			}
+			else
+			{
+				out += c;
+			}
+		}
+	}
+	out += '"';
+}
+
+} // namespace shim
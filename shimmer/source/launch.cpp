@@ -0,0 +1,77 @@
+// launch.cpp
+// Shimmer
+// author: beefviper
+// date: July 27, 2025
+
+#include "launch.hpp"
+
+#include <iostream>
+
+namespace shim
+{
+
+// ProcessIoPriority has no documented Win32 setter for another process; this is the call
+// Task Manager and Process Explorer use, so it is looked up at runtime rather than linked
+static constexpr ULONG PROCESS_IO_PRIORITY_CLASS = 33;
+using NtSetInformationProcessFn = LONG(NTAPI*)(HANDLE, ULONG, PVOID, ULONG);
+
+static DWORD priorityClass(Priority priority)
+{
+	switch (priority)
+	{
+	case Priority::Idle: return IDLE_PRIORITY_CLASS;
+	case Priority::BelowNormal: return BELOW_NORMAL_PRIORITY_CLASS;
+	case Priority::Normal: return NORMAL_PRIORITY_CLASS;
+	case Priority::AboveNormal: return ABOVE_NORMAL_PRIORITY_CLASS;
+	case Priority::High: return HIGH_PRIORITY_CLASS;
+	case Priority::Realtime: return REALTIME_PRIORITY_CLASS;
+	default: return 0;
+	}
+}
+
+static bool setIoPriority(HANDLE process, IoPriority ioPriority)
+{
+	auto setInformation = reinterpret_cast<NtSetInformationProcessFn>(
+		GetProcAddress(GetModuleHandleA("ntdll.dll"), "NtSetInformationProcess"));
+	if (!setInformation)
+	{
+		return false;
+	}
+
+	// IoPriorityVeryLow = 0, IoPriorityLow = 1, IoPriorityNormal = 2
+	ULONG value = static_cast<ULONG>(ioPriority) - static_cast<ULONG>(IoPriority::VeryLow);
+	return setInformation(process, PROCESS_IO_PRIORITY_CLASS, &value, sizeof(value)) >= 0;
+}
+
+bool launch(const Shim& shim, std::string commandLine, bool inheritHandles,
+	STARTUPINFOA& startupInfo, PROCESS_INFORMATION& processInfo)
+{
+	// affinity and I/O priority need a process handle, so start the target suspended and let it
+	// run only once the whole policy is in place
+	bool needsHandle = shim.affinity != 0 || shim.ioPriority != IoPriority::Default;
+	DWORD flags = priorityClass(shim.priority) | (needsHandle ? CREATE_SUSPENDED : 0);
+
+	if (!CreateProcessA(NULL, &commandLine[0], NULL, NULL, inheritHandles ? TRUE : FALSE, flags, NULL, NULL, &startupInfo, &processInfo))
+	{
+		return false;
+	}
+
+	if (needsHandle)
+	{
+		if (shim.affinity != 0 && !SetProcessAffinityMask(processInfo.hProcess, static_cast<DWORD_PTR>(shim.affinity)))
+		{
+			std::cerr << "Warning: Unable to set CPU affinity for " << shim.alias << std::endl;
+		}
+
+		if (shim.ioPriority != IoPriority::Default && !setIoPriority(processInfo.hProcess, shim.ioPriority))
+		{
+			std::cerr << "Warning: Unable to set I/O priority for " << shim.alias << std::endl;
+		}
+
+		ResumeThread(processInfo.hThread);
+	}
+
+	return true;
+}
+
+} // namespace shim
@@ -6,61 +6,148 @@
 #include <iostream>
 
 #include "shimmer.hpp"
+#include "bench.hpp"
+#include "memo.hpp"
+#include "admission.hpp"
+#include "launch.hpp"
+#include "embed.hpp"
+
+static int dispatch(shim::Shim target, const std::filesystem::path& installDir,
+	std::unique_ptr<shim::Shimmer> shimmer, int argc, char* argv[])
+{
+	// a shim of a shim goes straight to the end of the chain instead of launching the next stub
+	if (!target.resolved.empty())
+	{
+		target.program = target.resolved;
+	}
+
+	std::string args = shim::joinArgs(argc, argv);
+	std::string commandLine = "\"" + target.program + "\" " + args;
+
+	if (target.mode == shim::ShimMode::Memo)
+	{
+		shimmer.reset();
+		return shim::Memo(target, installDir / ".memo").run(commandLine, argc, argv);
+	}
+
+	std::optional<shim::Admission> admission;
+	if (target.maxConcurrent > 0)
+	{
+		admission.emplace(target, installDir / "admission.log");
+		if (!admission->acquire())
+		{
+			MessageBoxA(NULL, ("Timed out waiting for a free slot: " + target.alias).c_str(), "Launch Error", MB_OK | MB_ICONERROR);
+			return EXIT_FAILURE;
+		}
+	}
+
+	STARTUPINFOA startupInfo = { sizeof(startupInfo) };
+	PROCESS_INFORMATION processInfo = {};
+
+	if (!shim::launch(target, commandLine, false, startupInfo, processInfo))
+	{
+		MessageBoxA(NULL, ("Failed to launch: " + target.program).c_str(), "Launch Error", MB_OK | MB_ICONERROR);
+		return 0;
+	}
+
+	if (target.mode == shim::ShimMode::Detached)
+	{
+		CloseHandle(processInfo.hProcess);
+		CloseHandle(processInfo.hThread);
+		return 0;
+	}
+
+	// Windows has no execve, so the closest thing is to get out of the way: drop the shim
+	// table, registry handles and PATH copy, give the pages back, and leave Ctrl+C to the child
+	CloseHandle(processInfo.hThread);
+	target = {};
+	commandLine.clear();
+	commandLine.shrink_to_fit();
+	shimmer.reset();
+	SetConsoleCtrlHandler(NULL, TRUE);
+	SetProcessWorkingSetSize(GetCurrentProcess(), static_cast<SIZE_T>(-1), static_cast<SIZE_T>(-1));
+
+	WaitForSingleObject(processInfo.hProcess, INFINITE);
+	DWORD exitCode = EXIT_FAILURE;
+	GetExitCodeProcess(processInfo.hProcess, &exitCode);
+	CloseHandle(processInfo.hProcess);
+	return static_cast<int>(exitCode);
+}
 
 int main(int argc, char* argv[])
 {
-	shim::Shimmer shimmer;
+	// stubs stamped with embed=true carry their own record and launch without the registry or shimmer.ini
+	if (argc < 2 || !shim::isCommand(argv[1]))
+	{
+		char exePathRaw[MAX_PATH];
+		GetModuleFileNameA(NULL, exePathRaw, MAX_PATH);
+		std::filesystem::path exePath(exePathRaw);
+
+		std::optional<shim::Shim> embedded = shim::readEmbedded(exePath);
+		if (embedded && _stricmp(embedded->alias.c_str(), exePath.stem().string().c_str()) == 0)
+		{
+			return dispatch(std::move(*embedded), exePath.parent_path(), nullptr, argc, argv);
+		}
+	}
+
+	auto shimmer = std::make_unique<shim::Shimmer>();
 
-	if (_stricmp(shimmer.currentExeName.c_str(), "shimmer") == 0 && argc < 2)
+	if (_stricmp(shimmer->currentExeName.c_str(), "shimmer") == 0 && argc < 2)
 	{
-		shimmer.printHelp();
+		shimmer->printHelp();
 		return 0;
 	}
 
 	std::string command = argc > 1 ? argv[1] : "";
-	if (command != "--install" && command != "--uninstall" && command != "--init")
+	if (command != "--install" && command != "--uninstall" && command != "--init" && command != "--batch" &&
+		command != "--bench")
 	{
-		shimmer.ini = std::make_unique<shim::Ini>();
+		shimmer->ini = std::make_unique<shim::Ini>();
 	}
 	else if (command == "--init")
 	{
-		shimmer.ini = std::make_unique<shim::Ini>(shimmer.registry.read("InstalledPath"));
+		shimmer->ini = std::make_unique<shim::Ini>(shimmer->registry.read("InstalledPath"));
+	}
+	else if (command == "--batch")
+	{
+		// a batch may start with --install, so fall back to the directory shimmer runs from
+		std::filesystem::path installedPath = shimmer->registry.read("InstalledPath");
+		shimmer->ini = std::make_unique<shim::Ini>(installedPath.empty() ? shimmer->currentExeDir : installedPath);
 	}
 
 	if (command == "--install")
 	{
-		shimmer.install();
+		shimmer->install();
 	}
 	else if (command == "--uninstall")
 	{
-		shimmer.uninstall();
+		shimmer->uninstall();
 	}
 	else if (command == "--init")
 	{
-		shimmer.init();
+		shimmer->init();
 	}
 	else if (command == "--create" && argc > 3)
 	{
-		std::string name = argv[2];
-		std::string target = argv[3];
-		shim::ShimMode mode = shim::ShimMode::Wait;
-		if (argc > 4) {
-			mode = shim::parseMode(argv[4]);
+		auto shim = shim::makeShim(argv[2], argv[3], { argv + 4, argv + argc });
+		if (!shim)
+		{
+			return EXIT_FAILURE;
 		}
-		shimmer.create(name, target, mode);
+		shimmer->create(*shim);
 	}
 	else if (command == "--update" && argc > 2)
 	{
-		std::string target = argv[2];
-		shim::ShimMode mode = shim::ShimMode::Wait;
-		if (argc > 3) {
-			mode = shim::parseMode(argv[3]);
+		auto shim = shim::makeShim(shimmer->currentExeName, argv[2], { argv + 3, argv + argc });
+		if (!shim)
+		{
+			return EXIT_FAILURE;
 		}
-		shimmer.update(target, mode);
+		shimmer->update(*shim);
 	}
 	else if (command == "--remove")
 	{
-		std::string target = shimmer.currentExeName;
+		std::string target = shimmer->currentExeName;
 
 		if (argc > 2)
 		{
@@ -73,56 +160,107 @@ int main(int argc, char* argv[])
 			return 0;
 		}
 
-		shimmer.remove(target);
+		shimmer->remove(target);
 	}
 	else if (command == "--list")
 	{
-		shimmer.list();
+		shim::ListFilter filter;
+		for (int i = 2; i < argc; i += 2)
+		{
+			std::string option = argv[i];
+			std::string value = i + 1 < argc ? argv[i + 1] : "";
+			std::optional<shim::ListFormat> format = shim::parseFormat(value);
+
+			if (option == "--prefix" && i + 1 < argc)
+			{
+				filter.prefix = value;
+			}
+			else if (option == "--mode" && (value == "wait" || value == "detached" || value == "memo"))
+			{
+				filter.mode = shim::parseMode(value);
+			}
+			else if (option == "--format" && format)
+			{
+				filter.format = *format;
+			}
+			else
+			{
+				std::cerr << "Error: Invalid --list option: " << option << " " << value << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		shimmer->list(filter);
 	}
 	else if (command == "--rebuild")
 	{
-		shimmer.rebuild();
+		shimmer->rebuild();
 	}
-	else if (command == "--version")
-	{
-		shimmer.version();
-	}
-	else
+	else if (command == "--doctor")
 	{
-		auto shims = shimmer.ini->getShims();
-		auto it = std::find_if(shims.begin(), shims.end(),
-			[&](const shim::Shim& shim) { return shim.alias == shimmer.currentExeName; });
-
-		if (it == shims.end())
+		shim::ListFormat format = shim::ListFormat::Tsv;
+		for (int i = 2; i < argc; i += 2)
 		{
-			MessageBoxA(NULL, ("Shim not found: " + it->alias).c_str(), "Error", MB_OK | MB_ICONERROR);
-			return 0;
-		}
-
-		std::string args = shim::joinArgs(argc, argv);
-		std::string commandLine = "\"" + it->program + "\" " + args;
+			std::string option = argv[i];
+			std::string value = i + 1 < argc ? argv[i + 1] : "";
+			std::optional<shim::ListFormat> parsed = shim::parseFormat(value);
 
-		STARTUPINFOA startupInfo = { sizeof(startupInfo) };
-		PROCESS_INFORMATION processInfo = {};
-
-		if (!CreateProcessA(NULL, &commandLine[0], NULL, NULL, FALSE, 0, NULL, NULL, &startupInfo, &processInfo))
+			if (option == "--format" && parsed)
+			{
+				format = *parsed;
+			}
+			else
+			{
+				std::cerr << "Error: Invalid --doctor option: " << option << " " << value << std::endl;
+				std::cerr << "Usage: shimmer.exe --doctor [--format text|json|tsv]" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		return shimmer->doctor(format) ? 0 : EXIT_FAILURE;
+	}
+	else if (command == "--stub" && argc > 2)
+	{
+		return shimmer->stub(argv[2]) ? 0 : EXIT_FAILURE;
+	}
+	else if (command == "--shell-init" && argc > 2)
+	{
+		return shimmer->shellInit(argv[2]) ? 0 : EXIT_FAILURE;
+	}
+	else if (command == "--batch" && argc > 2)
+	{
+		return shimmer->batch(argv[2]) ? 0 : EXIT_FAILURE;
+	}
+	else if (command == "--bench")
+	{
+		std::vector<size_t> sizes;
+		for (int i = 2; i < argc; ++i)
 		{
-			MessageBoxA(NULL, ("Failed to launch: " + it->program).c_str(), "Launch Error", MB_OK | MB_ICONERROR);
-			return 0;
+			try
+			{
+				sizes.push_back(std::stoull(argv[i]));
+			}
+			catch (const std::exception&)
+			{
+				std::cerr << "Error: Invalid --bench size: " << argv[i] << std::endl;
+				std::cerr << "Usage: shimmer.exe --bench [n...]" << std::endl;
+				return EXIT_FAILURE;
+			}
 		}
-
-		if (it->mode == shim::ShimMode::Detached)
+		shim::Bench(sizes).run();
+	}
+	else if (command == "--version")
+	{
+		shimmer->version();
+	}
+	else
+	{
+		std::optional<shim::Shim> found = shimmer->ini->resolve(shimmer->currentExeName);
+		if (!found)
 		{
-			CloseHandle(processInfo.hProcess);
-			CloseHandle(processInfo.hThread);
+			MessageBoxA(NULL, ("Shim not found: " + shimmer->currentExeName).c_str(), "Error", MB_OK | MB_ICONERROR);
 			return 0;
 		}
 
-		WaitForSingleObject(processInfo.hProcess, INFINITE);
-		DWORD exitCode;
-		GetExitCodeProcess(processInfo.hProcess, &exitCode);
-		CloseHandle(processInfo.hProcess);
-		CloseHandle(processInfo.hThread);
-		return 0;
+		std::filesystem::path installDir = shimmer->ini->getPath().parent_path();
+		return dispatch(*found, installDir, std::move(shimmer), argc, argv);
 	}
 }
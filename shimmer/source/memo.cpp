@@ -0,0 +1,305 @@
+// memo.cpp
+// Shimmer
+// author: beefviper
+// date: July 27, 2025
+
+#include "memo.hpp"
+#include "admission.hpp"
+#include "launch.hpp"
+
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+#include <Windows.h>
+
+namespace shim
+{
+
+static constexpr const char* MEMO_MAGIC = "SHIMMEMO1";
+
+static std::string hashKey(const std::string& key)
+{
+	// FNV-1a, only used to name the entry; the full key is stored and compared on every hit
+	std::uint64_t hash = 14695981039346656037ull;
+	for (unsigned char c : key)
+	{
+		hash ^= c;
+		hash *= 1099511628211ull;
+	}
+
+	std::ostringstream name;
+	name << std::hex << std::setw(16) << std::setfill('0') << hash;
+	return name.str();
+}
+
+static void writeAll(HANDLE handle, const char* data, size_t size)
+{
+	while (size > 0)
+	{
+		DWORD written = 0;
+		if (!WriteFile(handle, data, static_cast<DWORD>(size), &written, nullptr) || written == 0)
+		{
+			return;
+		}
+		data += written;
+		size -= written;
+	}
+}
+
+static void pump(HANDLE source, HANDLE sink, std::string& captured)
+{
+	char chunk[4096];
+	DWORD got = 0;
+	while (ReadFile(source, chunk, sizeof(chunk), &got, nullptr) && got > 0)
+	{
+		captured.append(chunk, got);
+		writeAll(sink, chunk, got);
+	}
+}
+
+Memo::Memo(const Shim& shim, const std::filesystem::path& cacheRoot) :
+	shim(shim),
+	cacheDir(cacheRoot / shim.alias)
+{
+}
+
+int Memo::run(const std::string& commandLine, int argc, char* argv[]) const
+{
+	std::string key = cacheKey(argc, argv);
+	std::filesystem::path entry = cacheDir / (hashKey(key) + ".memo");
+
+	if (!key.empty())
+	{
+		if (std::optional<int> exitCode = replay(entry, key))
+		{
+			return *exitCode;
+		}
+	}
+
+	std::optional<Admission> admission;
+	if (shim.maxConcurrent > 0)
+	{
+		admission.emplace(shim, cacheDir.parent_path().parent_path() / "admission.log");
+	}
+	if (admission && !admission->acquire())
+	{
+		MessageBoxA(NULL, ("Timed out waiting for a free slot: " + shim.alias).c_str(), "Launch Error", MB_OK | MB_ICONERROR);
+		return EXIT_FAILURE;
+	}
+
+	SECURITY_ATTRIBUTES inherit = { sizeof(inherit), nullptr, TRUE };
+	HANDLE outRead = nullptr;
+	HANDLE outWrite = nullptr;
+	HANDLE errRead = nullptr;
+	HANDLE errWrite = nullptr;
+	CreatePipe(&outRead, &outWrite, &inherit, 0);
+	CreatePipe(&errRead, &errWrite, &inherit, 0);
+	SetHandleInformation(outRead, HANDLE_FLAG_INHERIT, 0);
+	SetHandleInformation(errRead, HANDLE_FLAG_INHERIT, 0);
+
+	STARTUPINFOA startupInfo = { sizeof(startupInfo) };
+	startupInfo.dwFlags = STARTF_USESTDHANDLES;
+	startupInfo.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+	startupInfo.hStdOutput = outWrite;
+	startupInfo.hStdError = errWrite;
+
+	PROCESS_INFORMATION processInfo = {};
+	bool launched = launch(shim, commandLine, true, startupInfo, processInfo);
+	CloseHandle(outWrite);
+	CloseHandle(errWrite);
+
+	if (!launched)
+	{
+		CloseHandle(outRead);
+		CloseHandle(errRead);
+		MessageBoxA(NULL, ("Failed to launch: " + shim.program).c_str(), "Launch Error", MB_OK | MB_ICONERROR);
+		return EXIT_FAILURE;
+	}
+
+	// pass output through as it arrives while keeping a copy; both pipes must drain or the child blocks
+	std::string out;
+	std::string err;
+	std::thread errPump(pump, errRead, GetStdHandle(STD_ERROR_HANDLE), std::ref(err));
+	pump(outRead, GetStdHandle(STD_OUTPUT_HANDLE), out);
+	errPump.join();
+	CloseHandle(outRead);
+	CloseHandle(errRead);
+
+	WaitForSingleObject(processInfo.hProcess, INFINITE);
+	DWORD exitCode = EXIT_FAILURE;
+	GetExitCodeProcess(processInfo.hProcess, &exitCode);
+	CloseHandle(processInfo.hProcess);
+	CloseHandle(processInfo.hThread);
+
+	if (!key.empty() && out.size() + err.size() <= shim.memoLimit)
+	{
+		store(entry, key, static_cast<int>(exitCode), out, err);
+		evict();
+	}
+
+	return static_cast<int>(exitCode);
+}
+
+std::string Memo::cacheKey(int argc, char* argv[]) const
+{
+	// the target's identity, so rebuilding or upgrading the tool invalidates its entries
+	std::error_code ec;
+	std::uintmax_t size = std::filesystem::file_size(shim.program, ec);
+	if (ec)
+	{
+		return {};
+	}
+	auto modified = std::filesystem::last_write_time(shim.program, ec);
+	if (ec)
+	{
+		return {};
+	}
+
+	std::string key = shim.program + '\0' + std::to_string(size) + '\0' +
+		std::to_string(modified.time_since_epoch().count()) + '\0';
+
+	for (int i = 1; i < argc; ++i)
+	{
+		key += argv[i];
+		key += '\0';
+	}
+
+	// tools like --print-config read files relative to where they run, so by default so does the cache
+	if (shim.memoCwd)
+	{
+		key += '\2' + std::filesystem::current_path(ec).string() + '\0';
+	}
+
+	for (const std::string& name : shim.memoEnv)
+	{
+		char buffer[32767];
+		DWORD length = GetEnvironmentVariableA(name.c_str(), buffer, sizeof(buffer));
+		key += '\1' + name + (length > 0 && length < sizeof(buffer) ? "=" + std::string(buffer, length) : "") + '\0';
+	}
+
+	return key;
+}
+
+std::optional<int> Memo::replay(const std::filesystem::path& entry, const std::string& key) const
+{
+	std::ifstream file(entry, std::ios::binary);
+	if (!file)
+	{
+		return std::nullopt;
+	}
+
+	std::string magic;
+	size_t keySize = 0;
+	int exitCode = 0;
+	size_t outSize = 0;
+	size_t errSize = 0;
+	file >> magic >> keySize >> exitCode >> outSize >> errSize;
+	file.get();
+
+	if (!file || magic != MEMO_MAGIC || keySize != key.size())
+	{
+		return std::nullopt;
+	}
+
+	std::string stored(keySize + outSize + errSize, '\0');
+	if (!file.read(stored.data(), static_cast<std::streamsize>(stored.size())) ||
+		stored.compare(0, keySize, key) != 0)
+	{
+		return std::nullopt;
+	}
+	file.close();
+
+	writeAll(GetStdHandle(STD_OUTPUT_HANDLE), stored.data() + keySize, outSize);
+	writeAll(GetStdHandle(STD_ERROR_HANDLE), stored.data() + keySize + outSize, errSize);
+
+	// the modification time doubles as the LRU clock
+	std::error_code ec;
+	std::filesystem::last_write_time(entry, std::filesystem::file_time_type::clock::now(), ec);
+	return exitCode;
+}
+
+void Memo::store(const std::filesystem::path& entry, const std::string& key, int exitCode,
+	const std::string& out, const std::string& err) const
+{
+	std::error_code ec;
+	std::filesystem::create_directories(cacheDir, ec);
+
+	std::filesystem::path tempPath = entry;
+	tempPath += "." + std::to_string(GetCurrentProcessId()) + ".tmp";
+
+	{
+		std::ofstream file(tempPath, std::ios::binary);
+		file << MEMO_MAGIC << ' ' << key.size() << ' ' << exitCode << ' ' << out.size() << ' ' << err.size() << '\n';
+		file.write(key.data(), static_cast<std::streamsize>(key.size()));
+		file.write(out.data(), static_cast<std::streamsize>(out.size()));
+		file.write(err.data(), static_cast<std::streamsize>(err.size()));
+		if (!file.flush())
+		{
+			file.close();
+			std::filesystem::remove(tempPath, ec);
+			return;
+		}
+	}
+
+	// concurrent misses for the same key race harmlessly: the last rename wins with identical content
+	std::filesystem::rename(tempPath, entry, ec);
+	if (ec)
+	{
+		std::filesystem::remove(tempPath, ec);
+	}
+}
+
+void Memo::evict() const
+{
+	struct Entry
+	{
+		std::filesystem::path path;
+		std::filesystem::file_time_type used;
+		std::uintmax_t size;
+	};
+
+	std::vector<Entry> entries;
+	std::uintmax_t total = 0;
+
+	std::error_code ec;
+	for (const auto& item : std::filesystem::directory_iterator(cacheDir, ec))
+	{
+		if (item.path().extension() != ".memo")
+		{
+			continue;
+		}
+
+		std::error_code statEc;
+		Entry entry{ item.path(), item.last_write_time(statEc), item.file_size(statEc) };
+		if (!statEc)
+		{
+			total += entry.size;
+			entries.push_back(std::move(entry));
+		}
+	}
+
+	if (total <= shim.memoLimit)
+	{
+		return;
+	}
+
+	std::sort(entries.begin(), entries.end(),
+		[](const Entry& a, const Entry& b) { return a.used < b.used; });
+
+	for (const Entry& entry : entries)
+	{
+		if (total <= shim.memoLimit)
+		{
+			break;
+		}
+		if (std::filesystem::remove(entry.path, ec))
+		{
+			total -= entry.size;
+		}
+	}
+}
+
+} // namespace shim
@@ -16,7 +16,13 @@ namespace shim
 
 static constexpr const char* REG_PATH_VALUE = "PATH";
 
-Path::Path()
+Path::Path() :
+	Path("Environment")
+{
+}
+
+Path::Path(const std::string& subKey) :
+	registry(subKey)
 {
 	std::string pathStr = registry.read(REG_PATH_VALUE);
 	paths = splitEnvPaths(pathStr);
@@ -43,9 +49,11 @@ void Path::add(const std::filesystem::path& newPath)
 	}
 
 	paths.push_back(newPath);
-	std::string joined = joinEnvPaths(paths);
-	registry.write(REG_PATH_VALUE, joined);
-	broadcastChange();
+	dirty = true;
+	if (!deferred)
+	{
+		commit();
+	}
 }
 
 void Path::remove(const std::filesystem::path& targetPath)
@@ -60,12 +68,33 @@ void Path::remove(const std::filesystem::path& targetPath)
 	if (it != paths.end())
 	{
 		paths.erase(it, paths.end());
-		std::string joined = joinEnvPaths(paths);
-		registry.write(REG_PATH_VALUE, joined);
-		broadcastChange();
+		dirty = true;
+		if (!deferred)
+		{
+			commit();
+		}
 	}
 }
 
+void Path::begin()
+{
+	deferred = true;
+}
+
+void Path::commit()
+{
+	deferred = false;
+	if (!dirty)
+	{
+		return;
+	}
+
+	std::string joined = joinEnvPaths(paths);
+	registry.write(REG_PATH_VALUE, joined);
+	broadcastChange();
+	dirty = false;
+}
+
 std::vector<std::filesystem::path> Path::splitEnvPaths(const std::string& pathStr)
 {
 	std::vector<std::filesystem::path> result;
@@ -0,0 +1,351 @@
+// pattern.cpp
+// Shimmer
+// author: beefviper
+// date: July 27, 2025
+
+#include "pattern.hpp"
+
+#include <map>
+#include <cctype>
+#include <fstream>
+#include <algorithm>
+
+namespace shim
+{
+
+static constexpr char DFA_MAGIC[8] = { 'S', 'H', 'I', 'M', 'D', 'F', 'A', '1' };
+
+// exe stems are case-insensitive on Windows
+static char fold(char c)
+{
+	return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+}
+
+static bool equalsFolded(const std::string& str, size_t pos, const std::string& part)
+{
+	if (pos + part.size() > str.size())
+	{
+		return false;
+	}
+	for (size_t i = 0; i < part.size(); ++i)
+	{
+		if (fold(str[pos + i]) != fold(part[i]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool isPattern(const std::string& alias)
+{
+	return alias.find('*') != std::string::npos;
+}
+
+bool matchCaptures(const std::string& pattern, const std::string& name, std::vector<std::string>& captures)
+{
+	std::vector<std::string> parts;
+	size_t start = 0;
+	for (size_t star = pattern.find('*'); star != std::string::npos; star = pattern.find('*', start))
+	{
+		parts.push_back(pattern.substr(start, star - start));
+		start = star + 1;
+	}
+	parts.push_back(pattern.substr(start));
+
+	captures.clear();
+	if (parts.size() == 1)
+	{
+		return name.size() == pattern.size() && equalsFolded(name, 0, pattern);
+	}
+
+	// the first and last parts are anchored; each middle part takes its leftmost fit,
+	// which always finds a match for a glob when one exists
+	const std::string& head = parts.front();
+	const std::string& tail = parts.back();
+	if (name.size() < head.size() + tail.size() || !equalsFolded(name, 0, head) ||
+		!equalsFolded(name, name.size() - tail.size(), tail))
+	{
+		return false;
+	}
+
+	size_t pos = head.size();
+	size_t end = name.size() - tail.size();
+	for (size_t i = 1; i + 1 < parts.size(); ++i)
+	{
+		size_t found = pos;
+		while (found + parts[i].size() <= end && !equalsFolded(name, found, parts[i]))
+		{
+			++found;
+		}
+		if (found + parts[i].size() > end)
+		{
+			return false;
+		}
+
+		captures.push_back(name.substr(pos, found - pos));
+		pos = found + parts[i].size();
+	}
+	captures.push_back(name.substr(pos, end - pos));
+	return true;
+}
+
+std::string expandCaptures(const std::string& program, const std::string& name, const std::vector<std::string>& captures)
+{
+	// {0} is the whole name, {1}..{N} the text matched by each '*'; anything else is left as written
+	std::string expanded;
+	for (size_t i = 0; i < program.size(); ++i)
+	{
+		size_t close = program[i] == '{' ? program.find('}', i) : std::string::npos;
+		if (close != std::string::npos && close > i + 1 && close - i <= 3 &&
+			std::all_of(program.begin() + i + 1, program.begin() + close, [](char c) { return std::isdigit(static_cast<unsigned char>(c)); }))
+		{
+			size_t n = std::stoul(program.substr(i + 1, close - i - 1));
+			if (n <= captures.size())
+			{
+				expanded += n == 0 ? name : captures[n - 1];
+				i = close;
+				continue;
+			}
+		}
+		expanded += program[i];
+	}
+	return expanded;
+}
+
+PatternMatcher::PatternMatcher(const std::vector<std::string>& patterns) :
+	rules(patterns)
+{
+}
+
+void PatternMatcher::compile()
+{
+	compiled = false;
+	classCount = 1;
+	transitions.clear();
+	accepting.clear();
+
+	// every literal character gets its own input class; class 0 is everything else, which only '*' accepts
+	std::vector<std::uint8_t> literalClass(256, 0);
+	for (const std::string& rule : rules)
+	{
+		for (char c : rule)
+		{
+			unsigned char folded = static_cast<unsigned char>(fold(c));
+			if (c != '*' && literalClass[folded] == 0)
+			{
+				literalClass[folded] = static_cast<std::uint8_t>(classCount++);
+			}
+		}
+	}
+	if (classCount > 255)
+	{
+		return;
+	}
+	for (int c = 0; c < 256; ++c)
+	{
+		classOf[c] = literalClass[static_cast<unsigned char>(fold(static_cast<char>(c)))];
+	}
+
+	// NFA states are (rule, position in rule); a DFA state is a sorted set of them
+	using NfaSet = std::vector<std::uint64_t>;
+	auto encode = [](size_t rule, size_t pos) { return (static_cast<std::uint64_t>(rule) << 32) | pos; };
+
+	auto close = [&](NfaSet& set)
+		{
+			for (size_t i = 0; i < set.size(); ++i)
+			{
+				size_t rule = static_cast<size_t>(set[i] >> 32);
+				size_t pos = static_cast<size_t>(set[i] & 0xffffffff);
+				if (pos < rules[rule].size() && rules[rule][pos] == '*')
+				{
+					set.push_back(encode(rule, pos + 1));
+				}
+			}
+			std::sort(set.begin(), set.end());
+			set.erase(std::unique(set.begin(), set.end()), set.end());
+		};
+
+	std::map<NfaSet, std::uint32_t> ids;
+	std::vector<NfaSet> states{ {} };
+
+	NfaSet start;
+	for (size_t rule = 0; rule < rules.size(); ++rule)
+	{
+		start.push_back(encode(rule, 0));
+	}
+	close(start);
+	ids[{}] = DEAD_STATE;
+	ids[start] = START_STATE;
+	states.push_back(start);
+
+	transitions.assign(2 * classCount, DEAD_STATE);
+	for (size_t state = START_STATE; state < states.size(); ++state)
+	{
+		for (size_t cls = 0; cls < classCount; ++cls)
+		{
+			NfaSet next;
+			for (std::uint64_t item : states[state])
+			{
+				size_t rule = static_cast<size_t>(item >> 32);
+				size_t pos = static_cast<size_t>(item & 0xffffffff);
+				if (pos >= rules[rule].size())
+				{
+					continue;
+				}
+
+				char c = rules[rule][pos];
+				if (c == '*')
+				{
+					next.push_back(item);
+				}
+				else if (literalClass[static_cast<unsigned char>(fold(c))] == cls)
+				{
+					next.push_back(encode(rule, pos + 1));
+				}
+			}
+			close(next);
+
+			auto [it, inserted] = ids.emplace(next, static_cast<std::uint32_t>(states.size()));
+			if (inserted)
+			{
+				if (states.size() >= MAX_STATES)
+				{
+					// pathological rule sets fall back to trying each rule in order
+					transitions.clear();
+					return;
+				}
+				states.push_back(std::move(next));
+				transitions.resize(states.size() * classCount, DEAD_STATE);
+			}
+			transitions[state * classCount + cls] = it->second;
+		}
+	}
+
+	accepting.assign(states.size(), NO_RULE);
+	for (size_t state = START_STATE; state < states.size(); ++state)
+	{
+		for (std::uint64_t item : states[state])
+		{
+			size_t rule = static_cast<size_t>(item >> 32);
+			if ((item & 0xffffffff) == rules[rule].size())
+			{
+				accepting[state] = (std::min)(accepting[state], rule);
+			}
+		}
+	}
+	compiled = true;
+}
+
+std::uint64_t PatternMatcher::rulesHash() const
+{
+	// FNV-1a over the rules in order, so tables saved for another shimmer.ini are never used
+	std::uint64_t hash = 14695981039346656037ull;
+	for (const std::string& rule : rules)
+	{
+		for (unsigned char c : rule)
+		{
+			hash ^= c;
+			hash *= 1099511628211ull;
+		}
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+bool PatternMatcher::save(const std::filesystem::path& path) const
+{
+	if (!compiled)
+	{
+		return false;
+	}
+
+	// [magic][rules hash][class count][state count][class of each byte][transitions][accepting rule per state]
+	std::uint64_t header[3] = { rulesHash(), classCount, accepting.size() };
+	std::vector<std::uint32_t> accept(accepting.size());
+	std::transform(accepting.begin(), accepting.end(), accept.begin(),
+		[](size_t rule) { return rule == NO_RULE ? UINT32_MAX : static_cast<std::uint32_t>(rule); });
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(DFA_MAGIC, sizeof(DFA_MAGIC));
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(classOf.data()), static_cast<std::streamsize>(classOf.size()));
+	file.write(reinterpret_cast<const char*>(transitions.data()), static_cast<std::streamsize>(transitions.size() * sizeof(std::uint32_t)));
+	file.write(reinterpret_cast<const char*>(accept.data()), static_cast<std::streamsize>(accept.size() * sizeof(std::uint32_t)));
+	return static_cast<bool>(file.flush());
+}
+
+bool PatternMatcher::load(const std::filesystem::path& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	char magic[sizeof(DFA_MAGIC)];
+	std::uint64_t header[3];
+	if (!file.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), DFA_MAGIC) ||
+		!file.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != rulesHash() ||
+		header[1] == 0 || header[1] > 255 || header[2] <= START_STATE || header[2] > MAX_STATES)
+	{
+		return false;
+	}
+
+	std::vector<std::uint8_t> classes(256);
+	std::vector<std::uint32_t> table(static_cast<size_t>(header[1] * header[2]));
+	std::vector<std::uint32_t> accept(static_cast<size_t>(header[2]));
+	if (!file.read(reinterpret_cast<char*>(classes.data()), static_cast<std::streamsize>(classes.size())) ||
+		!file.read(reinterpret_cast<char*>(table.data()), static_cast<std::streamsize>(table.size() * sizeof(std::uint32_t))) ||
+		!file.read(reinterpret_cast<char*>(accept.data()), static_cast<std::streamsize>(accept.size() * sizeof(std::uint32_t))))
+	{
+		return false;
+	}
+
+	// a damaged file must not send match() out of bounds
+	bool valid = std::all_of(classes.begin(), classes.end(), [&](std::uint8_t cls) { return cls < header[1]; }) &&
+		std::all_of(table.begin(), table.end(), [&](std::uint32_t state) { return state < header[2]; }) &&
+		std::all_of(accept.begin(), accept.end(), [&](std::uint32_t rule) { return rule == UINT32_MAX || rule < rules.size(); });
+	if (!valid)
+	{
+		return false;
+	}
+
+	classOf = std::move(classes);
+	classCount = static_cast<size_t>(header[1]);
+	transitions = std::move(table);
+	accepting.resize(accept.size());
+	std::transform(accept.begin(), accept.end(), accepting.begin(),
+		[](std::uint32_t rule) { return rule == UINT32_MAX ? NO_RULE : static_cast<size_t>(rule); });
+	compiled = true;
+	return true;
+}
+
+std::optional<size_t> PatternMatcher::match(const std::string& name) const
+{
+	if (!compiled)
+	{
+		std::vector<std::string> captures;
+		for (size_t rule = 0; rule < rules.size(); ++rule)
+		{
+			if (matchCaptures(rules[rule], name, captures))
+			{
+				return rule;
+			}
+		}
+		return std::nullopt;
+	}
+
+	std::uint32_t state = START_STATE;
+	for (char c : name)
+	{
+		state = transitions[state * classCount + classOf[static_cast<unsigned char>(c)]];
+		if (state == DEAD_STATE)
+		{
+			return std::nullopt;
+		}
+	}
+
+	if (accepting[state] == NO_RULE)
+	{
+		return std::nullopt;
+	}
+	return accepting[state];
+}
+
+} // namespace shim
@@ -0,0 +1,211 @@
+// shell.cpp
+// Shimmer
+// author: beefviper
+// date: July 27, 2025
+
+#include "shell.hpp"
+#include "shimmer.hpp"
+
+#include <cctype>
+#include <fstream>
+#include <algorithm>
+
+namespace shim
+{
+
+static constexpr const char* SHELL_DIR = "shell";
+
+static const std::vector<std::pair<Shell, std::string>> SHELL_NAMES{
+	{ Shell::Bash, "bash" },
+	{ Shell::Zsh, "zsh" },
+	{ Shell::Fish, "fish" },
+	{ Shell::Pwsh, "pwsh" }
+};
+
+static const char* SHIMMER_COMMANDS =
+	"--install --uninstall --init --list --update --remove --create --rebuild "
+	"--doctor --batch --bench --shell-init --version";
+
+static std::string posixPath(const std::filesystem::path& path)
+{
+	// MSYS/Git Bash spelling: C:\tools\git.exe -> /c/tools/git.exe
+	std::string str = path.string();
+	std::replace(str.begin(), str.end(), '\\', '/');
+	if (str.size() >= 2 && str[1] == ':')
+	{
+		str = "/" + std::string(1, static_cast<char>(std::tolower(static_cast<unsigned char>(str[0])))) + str.substr(2);
+	}
+	return str;
+}
+
+static std::string quote(const std::string& str, Shell shell)
+{
+	std::string quoted = "'";
+	for (char c : str)
+	{
+		if (c == '\'')
+		{
+			quoted += shell == Shell::Pwsh ? "''" : shell == Shell::Fish ? "\\'" : "'\\''";
+		}
+		else if (c == '\\' && shell == Shell::Fish)
+		{
+			quoted += "\\\\";
+		}
+		else
+		{
+			quoted += c;
+		}
+	}
+	return quoted + "'";
+}
+
+std::optional<Shell> parseShell(const std::string& shellStr)
+{
+	for (const auto& [shell, name] : SHELL_NAMES)
+	{
+		if (name == shellStr)
+		{
+			return shell;
+		}
+	}
+	return std::nullopt;
+}
+
+std::filesystem::path shellScriptPath(Shell shell, const std::filesystem::path& shimDir)
+{
+	for (const auto& [candidate, name] : SHELL_NAMES)
+	{
+		if (candidate == shell)
+		{
+			return shimDir / SHELL_DIR / ("init." + (shell == Shell::Pwsh ? std::string("ps1") : name));
+		}
+	}
+	return {};
+}
+
+std::string shellInit(Shell shell, const std::vector<Shim>& shims, const std::filesystem::path& shimDir)
+{
+	// every alias maps straight to its stub, so the shell never walks PATH to find one
+	std::vector<std::pair<std::string, std::filesystem::path>> commands{ { "shimmer", shimDir / "shimmer.exe" } };
+	std::string aliases;
+	for (const Shim& shim : shims)
+	{
+		// rules have no stub, and their '*' would be glob-expanded by the completion code
+		if (isPattern(shim.alias))
+		{
+			continue;
+		}
+		commands.emplace_back(shim.alias, shimDir / (shim.alias + ".exe"));
+		aliases += (aliases.empty() ? "" : " ") + shim.alias;
+	}
+
+	std::string script = "# generated by shimmer from shimmer.ini; do not edit\n";
+
+	switch (shell)
+	{
+	case Shell::Bash:
+		for (const auto& [name, stub] : commands)
+		{
+			script += "hash -p " + quote(posixPath(stub), shell) + " " + quote(name, shell) + "\n";
+		}
+		script +=
+			"_shimmer() {\n"
+			"\tlocal cur=${COMP_WORDS[COMP_CWORD]}\n"
+			"\tcase ${COMP_WORDS[COMP_CWORD-1]} in\n"
+			"\t\t--remove) COMPREPLY=($(compgen -W " + quote(aliases, shell) + " -- \"$cur\")) ;;\n"
+			"\t\t--shell-init) COMPREPLY=($(compgen -W 'bash zsh fish pwsh' -- \"$cur\")) ;;\n"
+			"\t\t*) COMPREPLY=($(compgen -W '" + SHIMMER_COMMANDS + "' -- \"$cur\")) ;;\n"
+			"\tesac\n"
+			"}\n"
+			"complete -F _shimmer shimmer shimmer.exe\n";
+		break;
+
+	case Shell::Zsh:
+		for (const auto& [name, stub] : commands)
+		{
+			script += "hash " + quote(name + "=" + posixPath(stub), shell) + "\n";
+		}
+		script +=
+			"_shimmer() {\n"
+			"\tcase ${words[CURRENT-1]} in\n"
+			"\t\t--remove) compadd -- " + aliases + " ;;\n"
+			"\t\t--shell-init) compadd -- bash zsh fish pwsh ;;\n"
+			"\t\t*) compadd -- " + SHIMMER_COMMANDS + " ;;\n"
+			"\tesac\n"
+			"}\n"
+			"(( $+functions[compdef] )) && compdef _shimmer shimmer shimmer.exe\n";
+		break;
+
+	case Shell::Fish:
+		// fish has no command hash, but functions are looked up before PATH
+		for (const auto& [name, stub] : commands)
+		{
+			script += "function " + quote(name, shell) + " --wraps " + quote(posixPath(stub), shell) + "; " +
+				quote(posixPath(stub), shell) + " $argv; end\n";
+		}
+		script +=
+			"complete -c shimmer -f -n 'not __fish_seen_subcommand_from --remove --shell-init' -a '" + std::string(SHIMMER_COMMANDS) + "'\n"
+			"complete -c shimmer -f -n '__fish_seen_subcommand_from --remove' -a " + quote(aliases, shell) + "\n"
+			"complete -c shimmer -f -n '__fish_seen_subcommand_from --shell-init' -a 'bash zsh fish pwsh'\n";
+		break;
+
+	case Shell::Pwsh:
+		// aliases resolve before any PATH lookup
+		for (const auto& [name, stub] : commands)
+		{
+			script += "Set-Alias -Name " + quote(name, shell) + " -Value " + quote(stub.string(), shell) + "\n";
+		}
+		script +=
+			"Register-ArgumentCompleter -Native -CommandName shimmer, shimmer.exe -ScriptBlock {\n"
+			"\tparam($wordToComplete, $commandAst)\n"
+			"\t$previous = $commandAst.CommandElements[-1].ToString()\n"
+			"\tif ($wordToComplete) { $previous = $commandAst.CommandElements[-2].ToString() }\n"
+			"\t$choices = switch ($previous) {\n"
+			"\t\t'--remove' { " + quote(aliases, shell) + " }\n"
+			"\t\t'--shell-init' { 'bash zsh fish pwsh' }\n"
+			"\t\tdefault { '" + SHIMMER_COMMANDS + "' }\n"
+			"\t}\n"
+			"\t$choices -split ' ' | Where-Object { $_ -and $_ -like \"$wordToComplete*\" }\n"
+			"}\n";
+		break;
+	}
+
+	return script;
+}
+
+bool writeShellScript(Shell shell, const std::vector<Shim>& shims, const std::filesystem::path& shimDir)
+{
+	std::filesystem::path scriptPath = shellScriptPath(shell, shimDir);
+	std::filesystem::path tempPath = scriptPath;
+	tempPath += ".tmp";
+
+	std::error_code ec;
+	std::filesystem::create_directories(scriptPath.parent_path(), ec);
+
+	{
+		std::ofstream file(tempPath, std::ios::binary);
+		std::string script = shellInit(shell, shims, shimDir);
+		if (!file.write(script.data(), static_cast<std::streamsize>(script.size())).flush())
+		{
+			return false;
+		}
+	}
+
+	std::filesystem::rename(tempPath, scriptPath, ec);
+	return !ec;
+}
+
+void refreshShellScripts(const std::vector<Shim>& shims, const std::filesystem::path& shimDir)
+{
+	// only shells someone has asked for once are kept current, so this costs a few stat calls otherwise
+	std::error_code ec;
+	for (const auto& [shell, name] : SHELL_NAMES)
+	{
+		if (std::filesystem::exists(shellScriptPath(shell, shimDir), ec))
+		{
+			writeShellScript(shell, shims, shimDir);
+		}
+	}
+}
+
+} // namespace shim
@@ -4,8 +4,12 @@
 // date: July 27, 2025
 
 #include "shimmer.hpp"
+#include "doctor.hpp"
+#include "shell.hpp"
 
 #include <iostream>
+#include <fstream>
+#include <algorithm>
 #include <string>
 
 namespace shim
@@ -20,9 +24,58 @@ shim::ShimMode parseMode(const std::string& modeStr)
 	{
 		return shim::ShimMode::Detached;
 	}
+	if (modeStr == "memo")
+	{
+		return shim::ShimMode::Memo;
+	}
 	return shim::ShimMode::Wait;
 }
 
+std::optional<shim::Shim> makeShim(const std::string& name, const std::string& target, const std::vector<std::string>& extra)
+{
+	shim::Shim shim{ name, target };
+	for (size_t i = 0; i < extra.size(); ++i)
+	{
+		if (i == 0 && extra[i].find('=') == std::string::npos)
+		{
+			shim.mode = parseMode(extra[i]);
+		}
+		else if (!applyOption(shim, extra[i]))
+		{
+			std::cerr << "Error: Invalid shim option: " << extra[i] << std::endl;
+			return std::nullopt;
+		}
+	}
+	return shim;
+}
+
+std::optional<shim::ListFormat> parseFormat(const std::string& formatStr)
+{
+	if (formatStr == "text")
+	{
+		return shim::ListFormat::Text;
+	}
+	if (formatStr == "json")
+	{
+		return shim::ListFormat::Json;
+	}
+	if (formatStr == "tsv")
+	{
+		return shim::ListFormat::Tsv;
+	}
+	return std::nullopt;
+}
+
+bool isCommand(const std::string& arg)
+{
+	static const char* COMMANDS[] = {
+		"--install", "--uninstall", "--init", "--create", "--update", "--remove", "--stub", "--list",
+		"--rebuild", "--doctor", "--batch", "--bench", "--shell-init", "--version"
+	};
+
+	return std::find(std::begin(COMMANDS), std::end(COMMANDS), arg) != std::end(COMMANDS);
+}
+
 std::string joinArgs(int argc, char* argv[])
 {
 	std::string joined;
@@ -36,6 +89,63 @@ std::string joinArgs(int argc, char* argv[])
 	return joined;
 }
 
+static std::vector<std::string> splitCommand(const std::string& line)
+{
+	// whitespace separated, double quotes group; backslashes stay literal so Windows paths survive
+	std::vector<std::string> tokens;
+	std::string token;
+	bool quoted = false;
+	bool pending = false;
+
+	for (char c : line)
+	{
+		if (c == '"')
+		{
+			quoted = !quoted;
+			pending = true;
+		}
+		else if (!quoted && (c == ' ' || c == '\t' || c == '\r'))
+		{
+			if (pending)
+			{
+				tokens.push_back(token);
+				token.clear();
+				pending = false;
+			}
+		}
+		else
+		{
+			token += c;
+			pending = true;
+		}
+	}
+
+	if (pending)
+	{
+		tokens.push_back(token);
+	}
+
+	return tokens;
+}
+
+static bool validBatchCommand(const std::vector<std::string>& args)
+{
+	const std::string& command = args[0];
+	if (command == "--create" || command == "--update")
+	{
+		return args.size() >= 3;
+	}
+	if (command == "--remove")
+	{
+		return args.size() == 2;
+	}
+	if (command == "--install")
+	{
+		return args.size() == 1;
+	}
+	return false;
+}
+
 Shimmer::Shimmer()
 {
 	char exePathRaw[MAX_PATH];
@@ -51,7 +161,14 @@ void Shimmer::install()
 {
 	if (registry.read(REG_INSTALLED_PATH).empty())
 	{
-		registry.write(REG_INSTALLED_PATH, currentExeDir.string());
+		if (batching)
+		{
+			pendingInstalledPath = currentExeDir.string();
+		}
+		else
+		{
+			registry.write(REG_INSTALLED_PATH, currentExeDir.string());
+		}
 		paths.add(currentExeDir);
 		std::cout << "Path :" << currentExeDir.string() << std::endl;
 		std::cout << "Shimmer installed successfully." << std::endl;
@@ -100,24 +217,141 @@ void Shimmer::init() const
 	}
 }
 
-void Shimmer::create(const std::string& name, const std::string& target, ShimMode mode) const
+bool Shimmer::create(const Shim& shim) const
+{
+	return ini->add(shim);
+}
+
+bool Shimmer::update(Shim shim) const
+{
+	shim.alias = currentExeName;
+	return ini->add(shim);
+}
+
+bool Shimmer::remove(std::string target) const
+{
+	return ini->remove(target);
+}
+
+bool Shimmer::stub(const std::string& name) const
+{
+	return ini->addRuleStub(name);
+}
+
+bool Shimmer::batch(const std::string& source)
 {
-	ini->add({ name, target, mode });
+	std::ifstream file;
+	std::istream* input = &std::cin;
+	if (source != "-")
+	{
+		file.open(source);
+		if (!file)
+		{
+			std::cerr << "Error: Unable to open batch file " << source << std::endl;
+			return false;
+		}
+		input = &file;
+	}
+
+	// parse the whole script up front so a typo on the last line aborts before anything runs
+	std::vector<std::pair<size_t, std::vector<std::string>>> commands;
+	std::string line;
+	size_t lineNumber = 0;
+	while (std::getline(*input, line))
+	{
+		++lineNumber;
+		std::vector<std::string> args = splitCommand(line);
+		if (args.empty() || args[0][0] == '#')
+		{
+			continue;
+		}
+
+		if (!validBatchCommand(args))
+		{
+			std::cerr << "Error: Invalid batch command on line " << lineNumber << ": " << line << std::endl;
+			return false;
+		}
+		commands.emplace_back(lineNumber, std::move(args));
+	}
+
+	batching = true;
+	paths.begin();
+	ini->begin();
+
+	// every command below only touches in-memory state; returning early discards it all
+	for (const auto& [number, args] : commands)
+	{
+		const std::string& command = args[0];
+		bool ok = true;
+
+		if (command == "--create" || command == "--update")
+		{
+			std::optional<Shim> shim = makeShim(args[1], args[2], { args.begin() + 3, args.end() });
+			bool replace = command == "--update";
+
+			ok = shim.has_value() && !(replace && args[1] == "shimmer");
+			if (ok && replace)
+			{
+				ini->remove(args[1]);
+			}
+			ok = ok && create(*shim);
+		}
+		else if (command == "--remove")
+		{
+			ok = args[1] != "shimmer" && remove(args[1]);
+		}
+		else if (command == "--install")
+		{
+			install();
+		}
+
+		if (!ok)
+		{
+			std::cerr << "Error: Batch aborted on line " << number << ", nothing was changed." << std::endl;
+			return false;
+		}
+	}
+
+	if (!ini->commit())
+	{
+		return false;
+	}
+
+	if (!pendingInstalledPath.empty())
+	{
+		registry.write(REG_INSTALLED_PATH, pendingInstalledPath);
+	}
+	paths.commit();
+	batching = false;
+
+	std::cout << "Batch committed: " << commands.size() << " commands." << std::endl;
+	return true;
 }
 
-void Shimmer::update(const std::string& target, ShimMode mode) const
+void Shimmer::list(const ListFilter& filter) const
 {
-	ini->add({ currentExeName, target, mode });
+	ini->list(filter);
 }
 
-void Shimmer::remove(std::string target) const
+bool Shimmer::doctor(ListFormat format) const
 {
-	ini->remove(target);
+	return Doctor(*ini, paths).run(format);
 }
 
-void Shimmer::list() const
+bool Shimmer::shellInit(const std::string& shellStr) const
 {
-	ini->list();
+	std::optional<Shell> shell = parseShell(shellStr);
+	if (!shell)
+	{
+		std::cerr << "Error: Unknown shell: " << shellStr << std::endl;
+		return false;
+	}
+
+	// keep a copy next to shimmer.ini; every later INI change regenerates it
+	std::filesystem::path shimDir = ini->getPath().parent_path();
+	writeShellScript(*shell, ini->getShims(), shimDir);
+	std::cout << shim::shellInit(*shell, ini->getShims(), shimDir);
+	return true;
 }
 
 void Shimmer::rebuild() const
@@ -140,11 +374,46 @@ Usage:
   shimmer.exe --install         Add current directory to user PATH
   shimmer.exe --uninstall       Remove current directory from PATH
   shimmer.exe --init            Create a default shimmer.ini file
-  shimmer.exe --list            List registered shims
-  shimmer.exe --update <target> Register current exe name to <target>
+  shimmer.exe --list [--prefix <p>] [--mode wait|detached|memo]
+                     [--format text|json|tsv]
+                                List registered shims, sorted by alias
+  shimmer.exe --update <target> [mode] [key=value...]
+                                Register current exe name to <target>
   shimmer.exe --remove          Remove current shim entry
-  shimmer.exe --create <name> <target> [wait|detached]
+  shimmer.exe --create <name> <target> [wait|detached|memo] [key=value...]
+                                Options: memo_env=VAR,VAR  memo_limit=<MiB>
+                                memo_cwd=false (share hits across dirs)
+                                max_concurrent=<1-64>  max_wait=<ms>
+                                affinity=<cpu list, e.g. 0,2-3>
+                                priority=idle|below_normal|normal|
+                                         above_normal|high|realtime
+                                io_priority=very_low|low|normal
+                                embed=true (stub launches without
+                                shimmer.ini; --rebuild after hand edits)
+                                A <name> with '*' is a rule for any stub
+                                it matches, e.g. clang-* with target
+                                "C:\llvm\{1}\bin\clang.exe"; exact
+                                names win over rules
+  shimmer.exe --stub <name>     Create the stub for a name a rule matches,
+                                e.g. --stub clang-16
+                                A <target> that is another shim's stub is
+                                followed to its final target on --create,
+                                --remove and --rebuild (shown as via= and
+                                resolved= in --list); cycles are refused
   shimmer.exe --rebuild         Recreate .exe stubs for all INI entries
+  shimmer.exe --doctor [--format text|json|tsv]
+                                Check every shim's target and stub, alias
+                                collisions, chains and PATH; exits 1 on
+                                problems
+  shimmer.exe --batch <file|->  Run --create/--remove/--install and
+                                --update <name> <target> [mode] [key=value...]
+                                lines
+                                as one all-or-nothing change
+  shimmer.exe --bench [n...]    Time management operations against
+                                synthetic configs of n shims each
+  shimmer.exe --shell-init bash|zsh|fish|pwsh
+                                Print a script that maps every shim to its
+                                stub; also kept current in shell\init.*
   shimmer.exe --version         Print version number
 )";
 }